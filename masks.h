@@ -1,224 +1,51 @@
-static const uint64_t downwards_diagonal_mask[14] = {
-    0x0000000000000001,
-    0x0000000000000102,
-    0x0000000000010204,
-    0x0000000001020408,
-    0x0000000102040810,
-    0x0000010204081020,
-    0x0001020408102040,
-    0x0102040810204080,
-    0x0204081020408000,
-    0x0408102040800000,
-    0x0810204080000000,
-    0x1020408000000000,
-    0x2040800000000000,
-    0x4080000000000000,
-    0x8000000000000000,
-};
-
-static const uint64_t upwards_diagonal_mask[14] = {
-    0x0000000000000080,
-    0x0000000000008040,
-    0x0000000000804020,
-    0x0000000080402010,
-    0x0000008040201008,
-    0x0000804020100804,
-    0x0080402010080402,
-    0x8040201008040201,
-    0x4020100804020100,
-    0x2010080402010000,
-    0x1008040201000000,
-    0x0804020100000000,
-    0x0402010000000000,
-    0x0201000000000000,
-    0x0100000000000000,
-};
-
-static const uint64_t row_mask[8] = {
-    0x00000000000000ff,
-    0x000000000000ff00,
-    0x0000000000ff0000,
-    0x00000000ff000000,
-    0x000000ff00000000,
-    0x0000ff0000000000,
-    0x00ff000000000000,
-    0xff00000000000000,
-};
-
-static const uint64_t column_mask[8] = {
-    0x0101010101010101,
-    0x0202020202020202,
-    0x0404040404040404,
-    0x0808080808080808,
-    0x1010101010101010,
-    0x2020202020202020,
-    0x4040404040404040,
-    0x8080808080808080,
-};
-
-static const uint64_t row_fill[32] = {
-    0x07, 0x0f, 0x1f, 0x3f, 0x7f, 0xff,
-    0x0e, 0x1e, 0x3e, 0x7e, 0xfe, 0x00,
-    0x1c, 0x3c, 0x7c, 0xfc, 0x00, 0x00,
-    0x38, 0x78, 0xf8, 0x00, 0x00, 0x00,
-    0x70, 0xf0, 0x00, 0x00, 0x00, 0x00,
-    0xe0, 0x00, 0x00, 0x00, 0x00, 0x00
-};
-
-static const uint64_t bottom_mask[6] = {
-    0x00000000000000ff,
-    0x000000000000ffff,
-    0x0000000000ffffff,
-    0x00000000ffffffff,
-    0x000000ffffffffff,
-    0x0000ffffffffffff,
-    0x00ffffffffffffff,
-};
-
-static const uint64_t column_fill[32] = {
-    0x0000000000010101,0x0000000001010101,0x0000000101010101,0x0000010101010101,0x0001010101010101,0x0101010101010101,
-    0x0000000001010100,0x0000000101010100,0x0000010101010100,0x0001010101010100,0x0101010101010100,0x0000000000000000,
-    0x0000000101010000,0x0000010101010000,0x0001010101010000,0x0101010101010000,0x0000000000000000,0x0000000000000000,
-    0x0000010101000000,0x0001010101000000,0x0101010101000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0001010100000000,0x0101010100000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0101010000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-};
-
-static const uint64_t upward_diagonal_fill[] = {
-    0x0000000000010204,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000001020400,0x0000000001020408,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000020408,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000102040000,0x0000000102040800,0x0000000102040810,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000002040800,0x0000000002040810,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000040810,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000010204000000,0x0000010204080000,0x0000010204081000,0x0000010204081020,0x0000000000000000,0x0000000000000000,
-    0x0000000204080000,0x0000000204081000,0x0000000204081020,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000004081000,0x0000000004081020,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000081020,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0001020400000000,0x0001020408000000,0x0001020408100000,0x0001020408102000,0x0001020408102040,0x0000000000000000,
-    0x0000020408000000,0x0000020408100000,0x0000020408102000,0x0000020408102040,0x0000000000000000,0x0000000000000000,
-    0x0000000408100000,0x0000000408102000,0x0000000408102040,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000008102000,0x0000000008102040,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000102040,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0102040000000000,0x0102040800000000,0x0102040810000000,0x0102040810200000,0x0102040810204000,0x0102040810204080,
-    0x0002040800000000,0x0002040810000000,0x0002040810200000,0x0002040810204000,0x0002040810204080,0x0000000000000000,
-    0x0000040810000000,0x0000040810200000,0x0000040810204000,0x0000040810204080,0x0000000000000000,0x0000000000000000,
-    0x0000000810200000,0x0000000810204000,0x0000000810204080,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000010204000,0x0000000010204080,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000204080,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0204080000000000,0x0204081000000000,0x0204081020000000,0x0204081020400000,0x0204081020408000,0x0204081020408100,
-    0x0004081000000000,0x0004081020000000,0x0004081020400000,0x0004081020408000,0x0004081020408100,0x0000000000000000,
-    0x0000081020000000,0x0000081020400000,0x0000081020408000,0x0000081020408100,0x0000000000000000,0x0000000000000000,
-    0x0000001020400000,0x0000001020408000,0x0000001020408100,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000020408000,0x0000000020408100,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000408100,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0408100000000000,0x0408102000000000,0x0408102040000000,0x0408102040800000,0x0408102040810000,0x0000000000000000,
-    0x0008102000000000,0x0008102040000000,0x0008102040800000,0x0008102040810000,0x0000000000000000,0x0000000000000000,
-    0x0000102040000000,0x0000102040800000,0x0000102040810000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000002040800000,0x0000002040810000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000040810000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0810200000000000,0x0810204000000000,0x0810204080000000,0x0810204081000000,0x0000000000000000,0x0000000000000000,
-    0x0010204000000000,0x0010204080000000,0x0010204081000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000204080000000,0x0000204081000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000004081000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x1020400000000000,0x1020408000000000,0x1020408100000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0020408000000000,0x0020408100000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000408100000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x2040800000000000,0x2040810000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0040810000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-};
-
-static const uint64_t downwards_diagonal_fill[] = {
-    0x0000000000804020,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000080402000,0x0000000080402010,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000402010,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000008040200000,0x0000008040201000,0x0000008040201008,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000040201000,0x0000000040201008,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000201008,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000804020000000,0x0000804020100000,0x0000804020100800,0x0000804020100804,0x0000000000000000,0x0000000000000000,
-    0x0000004020100000,0x0000004020100800,0x0000004020100804,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000020100800,0x0000000020100804,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000100804,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0080402000000000,0x0080402010000000,0x0080402010080000,0x0080402010080400,0x0080402010080402,0x0000000000000000,
-    0x0000402010000000,0x0000402010080000,0x0000402010080400,0x0000402010080402,0x0000000000000000,0x0000000000000000,
-    0x0000002010080000,0x0000002010080400,0x0000002010080402,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000010080400,0x0000000010080402,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000080402,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x8040200000000000,0x8040201000000000,0x8040201008000000,0x8040201008040000,0x8040201008040200,0x8040201008040201,
-    0x0040201000000000,0x0040201008000000,0x0040201008040000,0x0040201008040200,0x0040201008040201,0x0000000000000000,
-    0x0000201008000000,0x0000201008040000,0x0000201008040200,0x0000201008040201,0x0000000000000000,0x0000000000000000,
-    0x0000001008040000,0x0000001008040200,0x0000001008040201,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000008040200,0x0000000008040201,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000040201,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x4020100000000000,0x4020100800000000,0x4020100804000000,0x4020100804020000,0x4020100804020100,0x4020100804028100,
-    0x0020100800000000,0x0020100804000000,0x0020100804020000,0x0020100804020100,0x0020100804028100,0x0000000000000000,
-    0x0000100804000000,0x0000100804020000,0x0000100804020100,0x0000100804028100,0x0000000000000000,0x0000000000000000,
-    0x0000000804020000,0x0000000804020100,0x0000000804028100,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000004020100,0x0000000004028100,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000028100,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x2010080000000000,0x2010080400000000,0x2010080402000000,0x2010080402010000,0x2010080402810000,0x0000000000000000,
-    0x0010080400000000,0x0010080402000000,0x0010080402010000,0x0010080402810000,0x0000000000000000,0x0000000000000000,
-    0x0000080402000000,0x0000080402010000,0x0000080402810000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000402010000,0x0000000402810000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000002810000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x1008040000000000,0x1008040200000000,0x1008040201000000,0x1008040281000000,0x0000000000000000,0x0000000000000000,
-    0x0008040200000000,0x0008040201000000,0x0008040281000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000040201000000,0x0000040281000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000281000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0804020000000000,0x0804020100000000,0x0804028100000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0004020100000000,0x0004028100000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000028100000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0402010000000000,0x0402810000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0002810000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-    0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,0x0000000000000000,
-};
-
+#include <array>
+#include <cstdint>
+
+// Line masks of the board, generated at compile time. Square a1 is bit 0,
+// h1 bit 7 and h8 bit 63; rows run along the bytes.
+
+constexpr std::array<uint64_t, 8> make_row_masks() {
+    std::array<uint64_t, 8> masks = {};
+    for (int row = 0; row < 8; ++row) {
+        masks[row] = (uint64_t) 0xff << (8 * row);
+    }
+
+    return masks;
+}
+
+constexpr std::array<uint64_t, 8> make_column_masks() {
+    std::array<uint64_t, 8> masks = {};
+    for (int column = 0; column < 8; ++column) {
+        masks[column] = (uint64_t) 0x0101010101010101 << column;
+    }
+
+    return masks;
+}
+
+// Diagonals running up to the right are numbered row - column + 7, from h1
+// alone to a8 alone; those running up to the left row + column, from a1
+// alone to h8 alone.
+constexpr std::array<uint64_t, 15> make_diagonal_masks(bool upwards) {
+    std::array<uint64_t, 15> masks = {};
+    for (int index = 0; index < 64; ++index) {
+        int row = index >> 3;
+        int column = index & 7;
+        masks[upwards ? row - column + 7 : row + column] |= (uint64_t) 1 << index;
+    }
+
+    return masks;
+}
+
+constexpr std::array<uint64_t, 8> row_mask = make_row_masks();
+constexpr std::array<uint64_t, 8> column_mask = make_column_masks();
+constexpr std::array<uint64_t, 15> upwards_diagonal_mask = make_diagonal_masks(true);
+constexpr std::array<uint64_t, 15> downwards_diagonal_mask = make_diagonal_masks(false);
+
+static_assert(row_mask[7] == 0xff00000000000000, "row masks");
+static_assert(column_mask[1] == 0x0202020202020202, "column masks");
+static_assert(upwards_diagonal_mask[0] == 0x0000000000000080, "upwards diagonal masks");
+static_assert(upwards_diagonal_mask[7] == 0x8040201008040201, "upwards diagonal masks");
+static_assert(upwards_diagonal_mask[14] == 0x0100000000000000, "upwards diagonal masks");
+static_assert(downwards_diagonal_mask[0] == 0x0000000000000001, "downwards diagonal masks");
+static_assert(downwards_diagonal_mask[7] == 0x0102040810204080, "downwards diagonal masks");
+static_assert(downwards_diagonal_mask[14] == 0x8000000000000000, "downwards diagonal masks");
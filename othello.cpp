@@ -1,15 +1,44 @@
 #include <iostream>
+#include <algorithm>
 #include <cmath>
 #include <cstdint>
+#include <climits>
 #include <vector>
+#include <string>
+#include <sstream>
+#include <set>
 #include <random>
 #include <cstdlib>
-#include <ctime>
+#include <cstring>
+#include <cctype>
+#include <cerrno>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <new>
+#include <memory>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS
+#endif
 
 #include "masks.h"
 
 #define EPSILON 0.0000001
 #define EXPLORATION 1.5
+#define VIRTUAL_LOSS 3
+#define WIN_UNIT 16 // node statistics count wins in sixteenths, hence 64-bit
 #define DARK_INIT 0x0000001008000000
 #define LIGHT_INIT 0x0000000810000000
 
@@ -21,7 +50,7 @@ enum class Player {
     light = 1,
 };
 
-Player opponent(Player player) {
+constexpr Player opponent(Player player) {
     return static_cast<Player>(1 - static_cast<int>(player));
 }
 
@@ -31,6 +60,10 @@ private:
 public:
     BitBoard() : board(0) {}
     BitBoard(uint64_t board) : board(board) {}
+
+    uint64_t get_bits() {
+        return board;
+    }
     
     void debug_print() {
         for (int i = 7; i >= 0; --i) {
@@ -47,14 +80,21 @@ public:
     }
 
     int bits_set() { 
-        int n = 0;
+        return __builtin_popcountll(board);
+    }
+
+    // Index of the n-th (0-based) set bit counting from the least significant end.
+    int select_bit(int n) {
+#ifdef __BMI2__
+        return __builtin_ctzll(_pdep_u64((uint64_t) 1 << n, board));
+#else
         uint64_t b = board;
-        while (b != 0) {
-            n += b & 1;
-            b >>= 1;
+        for (int i = 0; i < n; ++i) {
+            b &= b - 1;
         }
 
-        return n;
+        return __builtin_ctzll(b);
+#endif
     }
 
     int peel_bit() {
@@ -130,166 +170,347 @@ public:
     }
 };
 
-// hacky, but efficient
-#define FILL_FUNCTION(NAME, SHIFT, MASK) \
-    BitBoard NAME##_fill(BitBoard gen, BitBoard pro) { \
-        BitBoard flood = gen; \
-        pro &= MASK; \
-        while (!gen.is_empty()) { \
-            flood |= gen; \
-            gen = (gen SHIFT) & pro; \
-        } \
-        return flood; \
-    } \
-    BitBoard NAME##_flood(BitBoard gen, BitBoard pro) { \
-        return (NAME##_fill(gen, pro) SHIFT) & MASK; \
-    } \
-    BitBoard NAME##_moves(BitBoard gen, BitBoard pro) { \
-        BitBoard flood = NAME##_fill(gen, pro); \
-        return ((flood & pro) SHIFT) & MASK; \
-    }
-
-FILL_FUNCTION(north, << 8, (uint64_t) 0xffffffffffffffff)
-FILL_FUNCTION(south, >> 8, (uint64_t) 0xffffffffffffffff)
-FILL_FUNCTION(west, >> 1, (uint64_t) WEST_MASK)
-FILL_FUNCTION(southwest, >> 9, (uint64_t) WEST_MASK)
-FILL_FUNCTION(northwest, << 7, (uint64_t) WEST_MASK)
-FILL_FUNCTION(east, << 1, (uint64_t) EAST_MASK)
-FILL_FUNCTION(northeast, << 9, (uint64_t) EAST_MASK)
-FILL_FUNCTION(southeast, >> 7, (uint64_t) EAST_MASK)
-   
-class Board {
-// private:
-public:
-    BitBoard bits[2];
+// Direction kernels. SHIFT is the bit distance of one step, positive
+// towards h8, and MASK clears the squares a step can only reach by wrapping
+// around an edge of the board.
+template <int SHIFT, uint64_t MASK>
+inline uint64_t step(uint64_t bits) {
+    return (SHIFT > 0 ? bits << SHIFT : bits >> -SHIFT) & MASK;
+}
 
-    BitBoard& disks(Player player) {
-        return bits[static_cast<int>(player)];
+// gen and every square reached from it through pro.
+template <int SHIFT, uint64_t MASK>
+inline uint64_t direction_fill(uint64_t gen, uint64_t pro) {
+    uint64_t flood = gen;
+    while (gen != 0) {
+        flood |= gen;
+        gen = step<SHIFT, MASK>(gen) & pro;
     }
 
-    BitBoard occupied() {
-        return disks(Player::dark) | disks(Player::light);
-    }
+    return flood;
+}
 
-    BitBoard move_bits(Player player) {
-        BitBoard empty = ~occupied();
-        BitBoard gen = disks(player);
-        BitBoard pro = disks(opponent(player));
-        BitBoard moves;
-        moves |= north_moves(gen, pro);
-        moves |= south_moves(gen, pro);
-        moves |= east_moves(gen, pro);
-        moves |= northeast_moves(gen, pro);
-        moves |= southeast_moves(gen, pro);
-        moves |= west_moves(gen, pro);
-        moves |= northwest_moves(gen, pro);
-        moves |= southwest_moves(gen, pro);
+// Squares one step past a run of pro that starts next to gen.
+template <int SHIFT, uint64_t MASK>
+inline uint64_t direction_moves(uint64_t gen, uint64_t pro) {
+    return step<SHIFT, MASK>(direction_fill<SHIFT, MASK>(gen, pro) & pro);
+}
 
-        return moves & empty;
+// The opponent disks a disk at placed turns over in one direction: the run
+// next to it, provided one of own closes it.
+template <int SHIFT, uint64_t MASK>
+inline uint64_t direction_flips(uint64_t placed, uint64_t own, uint64_t opp) {
+    uint64_t run = 0;
+    uint64_t bit = step<SHIFT, MASK>(placed);
+    while (bit & opp) {
+        run |= bit;
+        bit = step<SHIFT, MASK>(bit);
     }
 
-    Board place_disk(Player player, int index) {
-        Board board = *this;
-        BitBoard placed = BitBoard((uint64_t) 1 << index);
-        BitBoard own = disks(player);
-        BitBoard flipping = disks(opponent(player));
+    return (bit & own) != 0 ? run : 0;
+}
 
-        BitBoard flipped;
-    
-        BitBoard gen = placed;
-        BitBoard flood = gen;
-        BitBoard pro = flipping;
+// Move generators over raw bitboards: own disks, opponent disks, result
+// includes non-empty squares and is masked by the caller. All of them must
+// agree bit for bit; the scalar one is the reference and the portable
+// fallback.
+uint64_t move_bits_scalar(uint64_t own, uint64_t opp) {
+    return direction_moves<8, ~(uint64_t) 0>(own, opp)
+         | direction_moves<-8, ~(uint64_t) 0>(own, opp)
+         | direction_moves<1, EAST_MASK>(own, opp)
+         | direction_moves<9, EAST_MASK>(own, opp)
+         | direction_moves<-7, EAST_MASK>(own, opp)
+         | direction_moves<-1, WEST_MASK>(own, opp)
+         | direction_moves<7, WEST_MASK>(own, opp)
+         | direction_moves<-9, WEST_MASK>(own, opp);
+}
 
-        do {
-            flood |= gen = (gen >> 8) & pro;
-        } while (!gen.is_empty());
-       
-        if (((flood >> 8) & own) != 0) {
-            flipped |= flood;
-        }
+#ifdef HAVE_X86_KERNELS
+// Kogge-Stone fill of all eight directions at once. Runs of opponent disks
+// adjacent to our own are grown by s, 2s and 4s steps (covering the six
+// squares a run can span), with no data-dependent loop. The left-shifting
+// directions (north, east, northeast, northwest) share one vector and the
+// right-shifting ones the other.
+__attribute__((target("avx2")))
+uint64_t move_bits_avx2(uint64_t own, uint64_t opp) {
+    const __m256i shift = _mm256_set_epi64x(7, 9, 1, 8);
+    const __m256i shift2 = _mm256_add_epi64(shift, shift);
+    const __m256i shift4 = _mm256_add_epi64(shift2, shift2);
+    const __m256i left_mask = _mm256_set_epi64x(WEST_MASK, EAST_MASK, EAST_MASK, -1);
+    const __m256i right_mask = _mm256_set_epi64x(EAST_MASK, WEST_MASK, WEST_MASK, -1);
 
-        gen = placed;
-        flood = gen;
+    __m256i gen = _mm256_set1_epi64x(own);
+    __m256i pro = _mm256_set1_epi64x(opp);
 
-        do {
-            flood |= gen = (gen << 8) & pro;
-        } while (!gen.is_empty());
+    __m256i left_pro = _mm256_and_si256(pro, left_mask);
+    __m256i right_pro = _mm256_and_si256(pro, right_mask);
+    __m256i left = _mm256_and_si256(left_pro, _mm256_sllv_epi64(gen, shift));
+    __m256i right = _mm256_and_si256(right_pro, _mm256_srlv_epi64(gen, shift));
 
-        if (((flood << 8) & own) != 0) {
-            flipped |= flood;
-        }
+    left = _mm256_or_si256(left, _mm256_and_si256(left_pro, _mm256_sllv_epi64(left, shift)));
+    right = _mm256_or_si256(right, _mm256_and_si256(right_pro, _mm256_srlv_epi64(right, shift)));
 
-        gen = placed;
-        flood = gen;
-        pro = flipping & EAST_MASK;
+    left_pro = _mm256_and_si256(left_pro, _mm256_sllv_epi64(left_pro, shift));
+    right_pro = _mm256_and_si256(right_pro, _mm256_srlv_epi64(right_pro, shift));
+    left = _mm256_or_si256(left, _mm256_and_si256(left_pro, _mm256_sllv_epi64(left, shift2)));
+    right = _mm256_or_si256(right, _mm256_and_si256(right_pro, _mm256_srlv_epi64(right, shift2)));
 
-        do {
-            flood |= gen = (gen << 1) & pro;
-        } while (!gen.is_empty());
-   
-        if ((((flood << 1) & EAST_MASK) & own) != 0) {
-            flipped |= flood;
-        }
+    left_pro = _mm256_and_si256(left_pro, _mm256_sllv_epi64(left_pro, shift2));
+    right_pro = _mm256_and_si256(right_pro, _mm256_srlv_epi64(right_pro, shift2));
+    left = _mm256_or_si256(left, _mm256_and_si256(left_pro, _mm256_sllv_epi64(left, shift4)));
+    right = _mm256_or_si256(right, _mm256_and_si256(right_pro, _mm256_srlv_epi64(right, shift4)));
+
+    __m256i moves = _mm256_or_si256(
+        _mm256_and_si256(_mm256_sllv_epi64(left, shift), left_mask),
+        _mm256_and_si256(_mm256_srlv_epi64(right, shift), right_mask));
 
-        gen = placed;
-        flood = gen;
+    __m128i half = _mm_or_si128(_mm256_castsi256_si128(moves), _mm256_extracti128_si256(moves, 1));
+    return _mm_cvtsi128_si64(_mm_or_si128(half, _mm_unpackhi_epi64(half, half)));
+}
 
-        do {
-            flood |= gen = (gen << 9) & pro;
-        } while (!gen.is_empty());
+// GCC's own AVX-512 intrinsics trip -Wuninitialized on their undefined
+// pass-through operands.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+// Same fill with all eight directions in one register. Every lane rotates
+// left (a right shift by s is a rotate by 64 - s), and the lane masks also
+// clear the s squares a rotate wraps in, which is enough to keep the wrapped
+// bits out of every later step too.
+__attribute__((target("avx512f")))
+uint64_t move_bits_avx512(uint64_t own, uint64_t opp) {
+    const __m512i shift = _mm512_set_epi64(57, 55, 63, 56, 7, 9, 1, 8);
+    const __m512i shift2 = _mm512_set_epi64(50, 46, 62, 48, 14, 18, 2, 16);
+    const __m512i shift4 = _mm512_set_epi64(36, 28, 60, 32, 28, 36, 4, 32);
+    const __m512i mask = _mm512_set_epi64(
+        EAST_MASK & (~0ULL >> 7), WEST_MASK & (~0ULL >> 9), WEST_MASK & (~0ULL >> 1), ~0ULL >> 8,
+        WEST_MASK & (~0ULL << 7), EAST_MASK & (~0ULL << 9), EAST_MASK & (~0ULL << 1), ~0ULL << 8);
 
-        if ((((flood << 9) & EAST_MASK) & own) != 0) {
-            flipped |= flood;
-        }
+    __m512i gen = _mm512_set1_epi64(own);
+    __m512i pro = _mm512_and_si512(_mm512_set1_epi64(opp), mask);
+
+    __m512i run = _mm512_and_si512(pro, _mm512_rolv_epi64(gen, shift));
+    run = _mm512_or_si512(run, _mm512_and_si512(pro, _mm512_rolv_epi64(run, shift)));
+    pro = _mm512_and_si512(pro, _mm512_rolv_epi64(pro, shift));
+    run = _mm512_or_si512(run, _mm512_and_si512(pro, _mm512_rolv_epi64(run, shift2)));
+    pro = _mm512_and_si512(pro, _mm512_rolv_epi64(pro, shift2));
+    run = _mm512_or_si512(run, _mm512_and_si512(pro, _mm512_rolv_epi64(run, shift4)));
+
+    __m512i moves = _mm512_and_si512(_mm512_rolv_epi64(run, shift), mask);
+    return _mm512_reduce_or_epi64(moves);
+}
+#pragma GCC diagnostic pop
+#endif
+
+typedef uint64_t (*MoveKernel)(uint64_t own, uint64_t opp);
 
-        gen = placed;
-        flood = gen;
+struct MoveKernelInfo {
+    const char* name;
+    MoveKernel kernel;
+    bool supported;
+};
 
-        do {
-            flood |= gen = (gen >> 7) & pro;
-        } while (!gen.is_empty());
+// Every kernel this build knows about, fastest last.
+std::vector<MoveKernelInfo> move_kernels() {
+    std::vector<MoveKernelInfo> kernels;
+    kernels.push_back(MoveKernelInfo{"scalar", move_bits_scalar, true});
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    kernels.push_back(MoveKernelInfo{"avx2", move_bits_avx2, (bool) __builtin_cpu_supports("avx2")});
+    kernels.push_back(MoveKernelInfo{"avx512", move_bits_avx512, (bool) __builtin_cpu_supports("avx512f")});
+#endif
+    return kernels;
+}
 
-        if ((((flood >> 7) & EAST_MASK) & own) != 0) {
-            flipped |= flood;
+MoveKernelInfo best_move_kernel() {
+    MoveKernelInfo best = move_kernels()[0];
+    for (MoveKernelInfo& info : move_kernels()) {
+        if (info.supported) {
+            best = info;
         }
+    }
+
+    return best;
+}
+
+// Chosen once at startup from CPUID; --kernel can override it.
+MoveKernelInfo move_kernel = best_move_kernel();
 
-        gen = placed;
-        flood = gen;
-        pro = flipping & WEST_MASK;
+// Flip tables for a single line of up to eight squares, indexed by the
+// position of the new disk on that line. outflank[p][opp] holds the first
+// square past each run of opponent disks touching p, and flips[p][outflank]
+// the squares strictly between p and the outflanking disks, so
+// flips[p][outflank[p][opp] & own] is every disk a move at p turns over.
+// Also records, per square, where it sits on its two diagonals (the lines
+// in masks.h) for the PEXT path. Built at compile time.
+struct LineTables {
+    uint8_t outflank[8][256] = {};
+    uint8_t flips[8][256] = {};
+    uint8_t diagonal_position[64] = {};
+    uint8_t anti_diagonal_position[64] = {};
+
+    constexpr LineTables() {
+        for (int p = 0; p < 8; ++p) {
+            for (int line = 0; line < 256; ++line) {
+                int out = 0;
+                int flip = 0;
+                for (int direction = 1; direction >= -1; direction -= 2) {
+                    int q = p + direction;
+                    while (q >= 0 && q < 8 && ((line >> q) & 1)) {
+                        q += direction;
+                    }
+
+                    if (q >= 0 && q < 8 && q != p + direction) {
+                        out |= 1 << q;
+                    }
+
+                    for (q = p + direction; q >= 0 && q < 8; q += direction) {
+                        if ((line >> q) & 1) {
+                            for (int r = p + direction; r != q; r += direction) {
+                                flip |= 1 << r;
+                            }
+                            break;
+                        }
+                    }
+                }
 
-        do {
-            flood |= gen = (gen >> 1) & pro;
-        } while (!gen.is_empty());
+                outflank[p][line] = out;
+                flips[p][line] = flip;
+            }
+        }
 
-        if ((((flood >> 1) & WEST_MASK) & own) != 0) {
-            flipped |= flood;
+        for (int index = 0; index < 64; ++index) {
+            int row = index >> 3;
+            int column = index & 7;
+            uint64_t below = ((uint64_t) 1 << index) - 1;
+            diagonal_position[index] = __builtin_popcountll(upwards_diagonal_mask[row - column + 7] & below);
+            anti_diagonal_position[index] = __builtin_popcountll(downwards_diagonal_mask[row + column] & below);
         }
+    }
+
+    constexpr uint64_t line_flips(int position, uint64_t own, uint64_t opp) const {
+        return flips[position][outflank[position][opp & 0xff] & own & 0xff];
+    }
+};
+
+constexpr LineTables line_tables{};
+
+static_assert(line_tables.line_flips(0, 0x80, 0x7e) == 0x7e, "line tables");
+static_assert(line_tables.line_flips(3, 0x41, 0x36) == 0x36, "line tables");
+
+// Without BMI2 a line is gathered into a byte and scattered back with
+// multiplies. Columns are indexed by row, diagonals by column; a diagonal has
+// one square per column, so its byte has no collisions.
+inline uint64_t column_gather(uint64_t bits, int column) {
+    return (((bits >> column) & 0x0101010101010101) * 0x0102040810204080) >> 56;
+}
+
+inline uint64_t column_scatter(uint64_t line, int column) {
+    uint64_t spread = (line * 0x0101010101010101) & 0x8040201008040201;
+    return ((spread + 0x7f7f7f7f7f7f7f7f) & 0x8080808080808080) >> (7 - column);
+}
+
+inline uint64_t diagonal_gather(uint64_t bits, uint64_t mask) {
+    return ((bits & mask) * 0x0101010101010101) >> 56;
+}
+
+inline uint64_t diagonal_scatter(uint64_t line, uint64_t mask) {
+    return (line * 0x0101010101010101) & mask;
+}
+   
+class Board {
+// private:
+public:
+    BitBoard bits[2];
+
+    BitBoard& disks(Player player) {
+        return bits[static_cast<int>(player)];
+    }
+
+    template <Player P>
+    BitBoard& disks() {
+        return bits[static_cast<int>(P)];
+    }
+
+    BitBoard occupied() {
+        return disks(Player::dark) | disks(Player::light);
+    }
+
+    template <Player P>
+    BitBoard move_bits() {
+        BitBoard empty = ~occupied();
+        BitBoard moves = move_kernel.kernel(disks<P>().get_bits(), disks<opponent(P)>().get_bits());
+        return moves & empty;
+    }
+
+    BitBoard move_bits(Player player) {
+        return player == Player::dark ? move_bits<Player::dark>() : move_bits<Player::light>();
+    }
 
-        gen = placed;
-        flood = gen;
+    // Table-driven flips: the row, column and both diagonals through index
+    // are each gathered into a byte, looked up in line_tables and scattered
+    // back. Playing a square that flips nothing leaves the board unchanged.
+    template <Player P>
+    Board place_disk(int index) {
+        Board board = *this;
+        uint64_t own = disks<P>().get_bits();
+        uint64_t opp = disks<opponent(P)>().get_bits();
+        int row = index >> 3;
+        int column = index & 7;
+        uint64_t diagonal = upwards_diagonal_mask[row - column + 7];
+        uint64_t anti_diagonal = downwards_diagonal_mask[row + column];
 
-        do {
-            flood |= gen = (gen << 7) & pro;
-        } while (!gen.is_empty());
+        uint64_t flipped = line_tables.line_flips(column, own >> (8 * row), opp >> (8 * row)) << (8 * row);
+#ifdef __BMI2__
+        flipped |= _pdep_u64(line_tables.line_flips(row,
+            _pext_u64(own, column_mask[column]), _pext_u64(opp, column_mask[column])), column_mask[column]);
+        flipped |= _pdep_u64(line_tables.line_flips(line_tables.diagonal_position[index],
+            _pext_u64(own, diagonal), _pext_u64(opp, diagonal)), diagonal);
+        flipped |= _pdep_u64(line_tables.line_flips(line_tables.anti_diagonal_position[index],
+            _pext_u64(own, anti_diagonal), _pext_u64(opp, anti_diagonal)), anti_diagonal);
+#else
+        flipped |= column_scatter(line_tables.line_flips(row,
+            column_gather(own, column), column_gather(opp, column)), column);
+        flipped |= diagonal_scatter(line_tables.line_flips(column,
+            diagonal_gather(own, diagonal), diagonal_gather(opp, diagonal)), diagonal);
+        flipped |= diagonal_scatter(line_tables.line_flips(column,
+            diagonal_gather(own, anti_diagonal), diagonal_gather(opp, anti_diagonal)), anti_diagonal);
+#endif
 
-        if ((((flood << 7) & WEST_MASK) & own) != 0) {
-            flipped |= flood;
+        if (flipped != 0) {
+            board.disks<P>() |= flipped | ((uint64_t) 1 << index);
+            board.disks<opponent(P)>() &= ~flipped;
         }
 
-        gen = placed;
-        flood = gen;
+        return board;
+    }
+
+    Board place_disk(Player player, int index) {
+        return player == Player::dark ? place_disk<Player::dark>(index) : place_disk<Player::light>(index);
+    }
+
+    // The flood-fill flips, one direction kernel at a time. Kept as the
+    // reference the tables are validated against.
+    Board place_disk_reference(Player player, int index) {
+        Board board = *this;
+        uint64_t placed = (uint64_t) 1 << index;
+        uint64_t own = disks(player).get_bits();
+        uint64_t opp = disks(opponent(player)).get_bits();
 
-        do {
-            flood |= gen = (gen >> 9) & pro;
-        } while (!gen.is_empty());
+        uint64_t flipped = direction_flips<8, ~(uint64_t) 0>(placed, own, opp)
+                         | direction_flips<-8, ~(uint64_t) 0>(placed, own, opp)
+                         | direction_flips<1, EAST_MASK>(placed, own, opp)
+                         | direction_flips<9, EAST_MASK>(placed, own, opp)
+                         | direction_flips<-7, EAST_MASK>(placed, own, opp)
+                         | direction_flips<-1, WEST_MASK>(placed, own, opp)
+                         | direction_flips<7, WEST_MASK>(placed, own, opp)
+                         | direction_flips<-9, WEST_MASK>(placed, own, opp);
 
-        if ((((flood >> 9) & WEST_MASK) & own) != 0) {
-            flipped |= flood;
+        if (flipped != 0) {
+            board.disks(player) |= flipped | placed;
+            board.disks(opponent(player)) &= ~flipped;
         }
- 
-        board.disks(player) |= flipped;
-        board.disks(opponent(player)) &= ~flipped;
-        return board; 
+
+        return board;
     }
 
     Board(BitBoard dark, BitBoard light) : bits{dark, light} {}
@@ -395,205 +616,4324 @@ public:
     }
 
     bool operator==(Board other) {
-        return bits == other.bits;
+        return bits[0] == other.bits[0] && bits[1] == other.bits[1];
     }
 };
 
-std::random_device seeder;
-std::mt19937_64 engine(seeder());
-Player playout(Board start, Player player) {
-    Player turn = player;
-    Board board = start;
-    for (;;) {
-        std::vector<Board> moves = board.find_moves(turn);
-
-        if (moves.empty()) {
-            if (board.is_winner(Player::light)) {
-                return Player::light;
-            } else if (board.is_winner(Player::dark)) {
-                return Player::dark;
-            } else {
-                std::uniform_int_distribution<int> dist(0, 1);
-                return static_cast<Player>(dist(engine));
-            }
-        }
-        
-        std::uniform_int_distribution<int> dist(0, moves.size() - 1); 
-        board = moves[dist(engine)];
-        turn = opponent(turn);
-    }
+// SplitMix64 step: advances state and returns a well mixed 64-bit value.
+// Used to expand one seed into generator state and to derive stream seeds.
+inline uint64_t splitmix64(uint64_t& state) {
+    uint64_t z = (state += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
 }
 
-class Node {
+// xoshiro256** generator. Cheap enough to call once per playout ply, and
+// seeded explicitly so that a run can be replayed from its seed.
+class Rng {
 private:
-    Board board;
-    Player turn;
-    int wins;
-    int simulations;
-    std::vector<Node> children;
-    bool terminal_position;
+    uint64_t state[4];
+
+    static uint64_t rotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
 
-    bool is_leaf() {
-        return children.empty();
+public:
+    Rng(uint64_t seed = 0) {
+        this->seed(seed);
     }
 
-    double utc_value(Node& node) {
-        double mean = (double) (node.simulations -node.wins) / (node.simulations + EPSILON);
-        return mean + EXPLORATION * sqrt(log(simulations + 1) / (node.simulations + EPSILON));
+    // Stream stream of seed: distinct streams of one seed are independent,
+    // so each search thread can draw from its own.
+    void seed(uint64_t seed, uint64_t stream = 0) {
+        uint64_t mix = seed ^ (stream * 0xd1b54a32d192ed03);
+        for (int i = 0; i < 4; ++i) {
+            state[i] = splitmix64(mix);
+        }
     }
 
-    Node& select() {
-        unsigned int max_index = -1;
-        double max_value = -1;
+    uint64_t next() {
+        uint64_t result = rotl(state[1] * 5, 7) * 9;
+        uint64_t t = state[1] << 17;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = rotl(state[3], 45);
+        return result;
+    }
 
-        for (unsigned int i = 0; i < children.size(); ++i) {
-            double value = utc_value(children[i]);
-            if (max_value < value) {
-                max_value = value;
-                max_index = i;
+    uint64_t operator()() {
+        return next();
+    }
+
+    // Uniform in [0, n) by Lemire's multiply-shift; the division that
+    // removes the bias only runs when the low word lands in the short range.
+    uint32_t below(uint32_t n) {
+        uint64_t product = (next() >> 32) * n;
+        uint32_t low = (uint32_t) product;
+        if (low < n) {
+            uint32_t threshold = -n % n;
+            while (low < threshold) {
+                product = (next() >> 32) * n;
+                low = (uint32_t) product;
             }
         }
-        
-        return children[max_index];
+
+        return product >> 32;
     }
 
-    void expand() {
-        std::vector<Board> moves = board.find_moves(turn);
-        if (moves.empty()) {
-            terminal_position = true;
+    int coin() {
+        return next() >> 63;
+    }
+};
+
+// Seed every run derives its streams from; set by --seed, random otherwise.
+uint64_t master_seed = 0;
+
+// one generator per thread, search workers must not share generator state
+thread_local Rng rng;
+
+// Random playout kernel: each ply picks a uniformly random set bit of the
+// move mask and applies only that move, so no child positions are built and
+// nothing is allocated. Plies are unrolled in pairs so the side to move is a
+// template parameter rather than an index.
+template <Player P>
+bool playout_ply(Board& board) {
+    BitBoard moves = board.move_bits<P>();
+    if (moves.is_empty()) {
+        return false;
+    }
+
+    board = board.place_disk<P>(moves.select_bit(rng.below(moves.bits_set())));
+    return true;
+}
+
+Player playout_winner(Board& board) {
+    if (board.is_winner(Player::light)) {
+        return Player::light;
+    } else if (board.is_winner(Player::dark)) {
+        return Player::dark;
+    } else {
+        return static_cast<Player>(rng.coin());
+    }
+}
+
+template <Player P>
+Player playout_from(Board board) {
+    while (playout_ply<P>(board) && playout_ply<opponent(P)>(board)) {
+    }
+
+    return playout_winner(board);
+}
+
+Player playout(Board start, Player player) {
+    return player == Player::dark ? playout_from<Player::dark>(start) : playout_from<Player::light>(start);
+}
+
+// One game of a batched playout: the position to play out from and, once the
+// batch has run, who won it.
+struct PlayoutJob {
+    Board board;
+    Player turn;
+    Player winner;
+};
+
+// Largest batch a single leaf-parallel iteration may queue.
+#define MAX_BATCH 16
+
+// The lane helpers are always inlined into the kernels below, so returning
+// vectors never crosses an actual call boundary. GCC only reports this at
+// the end of the file, hence no push/pop around it. Arguments go by const
+// reference, as the note GCC prints for wide vectors passed by value
+// ignores the pragma.
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+// One uint64_t per lane, using GCC vector extensions so the same code lowers
+// to whatever vector width the enclosing function is compiled for.
+template <int LANES> struct LaneVector;
+template <> struct LaneVector<4> { typedef uint64_t type __attribute__((vector_size(32))); };
+template <> struct LaneVector<8> { typedef uint64_t type __attribute__((vector_size(64))); };
+template <> struct LaneVector<16> { typedef uint64_t type __attribute__((vector_size(128))); };
+
+template <int S, typename V>
+__attribute__((always_inline)) inline V lane_shift(const V& x) {
+    return S > 0 ? x << S : x >> -S;
+}
+
+// Opponent runs starting next to gen in direction S, at most six squares long.
+template <int S, typename V>
+__attribute__((always_inline)) inline V lane_run(const V& gen, const V& pro) {
+    V run = pro & lane_shift<S>(gen);
+    run |= pro & lane_shift<S>(run);
+    V pro2 = pro & lane_shift<S>(pro);
+    run |= pro2 & lane_shift<2 * S>(run);
+    V pro4 = pro2 & lane_shift<2 * S>(pro2);
+    run |= pro4 & lane_shift<4 * S>(run);
+    return run;
+}
+
+template <int S, uint64_t MASK, typename V>
+__attribute__((always_inline)) inline V lane_moves(const V& own, const V& opp) {
+    return lane_shift<S>(lane_run<S>(own, opp & MASK)) & MASK;
+}
+
+template <int S, uint64_t MASK, typename V>
+__attribute__((always_inline)) inline V lane_flips(const V& placed, const V& own, const V& opp) {
+    V run = lane_run<S>(placed, opp & MASK);
+    V closed = (V) ((lane_shift<S>(run) & MASK & own) != 0);
+    return run & closed;
+}
+
+// Plays count random games LANES at a time, one game per vector lane. Every
+// lane moves on the same step; a lane whose game ends records the winner and
+// is refilled from the remaining jobs, or masked out once there are none.
+// Moves are chosen per lane, but move generation and flipping run across all
+// lanes at once.
+template <int LANES>
+__attribute__((always_inline)) inline void batch_playouts_lanes(PlayoutJob* jobs, int count) {
+    typedef typename LaneVector<LANES>::type V;
+    const uint64_t all = ~(uint64_t) 0;
+
+    V own = {};
+    V opp = {};
+    Player turn[LANES];
+    int job[LANES];
+    int next = 0;
+    int active = 0;
+
+    // A freshly loaded lane sits out one step as a null move, so it is
+    // stored with the sides swapped and the swap at the end of the step
+    // puts its side to move in own.
+    auto load = [&](int lane) {
+        if (next < count) {
+            job[lane] = next;
+            turn[lane] = opponent(jobs[next].turn);
+            own[lane] = jobs[next].board.disks(turn[lane]).get_bits();
+            opp[lane] = jobs[next].board.disks(jobs[next].turn).get_bits();
+            ++next;
+            ++active;
         } else {
-            for (Board move : moves) {
-                children.emplace_back(Node(move, opponent(turn)));
-            }
+            job[lane] = -1;
+            own[lane] = 0;
+            opp[lane] = 0;
         }
+    };
+
+    V placed = {};
+    for (int lane = 0; lane < LANES; ++lane) {
+        load(lane);
     }
 
-    Player playout() {
-        return ::playout(board, turn);
+    V tmp = own;
+    own = opp;
+    opp = tmp;
+    for (int lane = 0; lane < LANES; ++lane) {
+        turn[lane] = opponent(turn[lane]);
     }
-public:
-    Node(Board board, Player turn) : board(board), turn(turn), wins(0), simulations(0), children(), terminal_position(false) {}
 
-    int mcts() {
-        if (is_leaf()) {
-            expand();
-        }
+    while (active > 0) {
+        V moves = lane_moves<8, all>(own, opp) | lane_moves<-8, all>(own, opp)
+                | lane_moves<1, EAST_MASK>(own, opp) | lane_moves<-1, WEST_MASK>(own, opp)
+                | lane_moves<9, EAST_MASK>(own, opp) | lane_moves<-9, WEST_MASK>(own, opp)
+                | lane_moves<7, WEST_MASK>(own, opp) | lane_moves<-7, EAST_MASK>(own, opp);
+        moves &= ~(own | opp);
 
-        if (terminal_position) {
-            int win;
-            if (board.is_winner(Player::dark)) {
-                win = Player::dark == turn;
-            } else if (board.is_winner(Player::light)) {
-                win = Player::light == turn;
-            } else {
-                int half = RAND_MAX / 2;
-                if (rand() % 2 <= half)
-                    win = 1;
-                else
-                    win = 0;
+        for (int lane = 0; lane < LANES; ++lane) {
+            placed[lane] = 0;
+            if (job[lane] < 0) {
+                continue;
             }
 
-            simulations += 1;
-            wins += win;
-            return win;
+            BitBoard lane_moves(moves[lane]);
+            if (lane_moves.is_empty()) {
+                int mine = __builtin_popcountll(own[lane]);
+                int theirs = __builtin_popcountll(opp[lane]);
+                Player winner;
+                if (mine != theirs) {
+                    winner = mine > theirs ? turn[lane] : opponent(turn[lane]);
+                } else {
+                    winner = static_cast<Player>(rng.coin());
+                }
+
+                jobs[job[lane]].winner = winner;
+                --active;
+                load(lane);
+                continue;
+            }
+
+            placed[lane] = (uint64_t) 1 << lane_moves.select_bit(rng.below(lane_moves.bits_set()));
         }
-        
-        Node& next = select();
 
-        int win;
-        if (next.simulations == 0) {
-            win = next.playout() == turn;
-            next.wins += 1 - win;
-            next.simulations += 1;
-        } else {
-            win = 1 - next.mcts();
+        V flipped = lane_flips<8, all>(placed, own, opp) | lane_flips<-8, all>(placed, own, opp)
+                  | lane_flips<1, EAST_MASK>(placed, own, opp) | lane_flips<-1, WEST_MASK>(placed, own, opp)
+                  | lane_flips<9, EAST_MASK>(placed, own, opp) | lane_flips<-9, WEST_MASK>(placed, own, opp)
+                  | lane_flips<7, WEST_MASK>(placed, own, opp) | lane_flips<-7, EAST_MASK>(placed, own, opp);
+
+        V mover = own | flipped | placed;
+        own = opp & ~flipped;
+        opp = mover;
+        for (int lane = 0; lane < LANES; ++lane) {
+            turn[lane] = opponent(turn[lane]);
         }
+    }
+}
 
-        wins += win;
-        simulations += 1;
-        return win;
+// lanes is 4, 8 or 16; the instantiations below only differ in which
+// instruction set the vector extensions are lowered to.
+#define BATCH_PLAYOUT_BODY \
+    switch (lanes) { \
+    case 4: batch_playouts_lanes<4>(jobs, count); break; \
+    case 8: batch_playouts_lanes<8>(jobs, count); break; \
+    default: batch_playouts_lanes<16>(jobs, count); break; \
     }
 
-    Node& best_move() {
-        unsigned int max_index = -1;
-        int max_simulations = -1;
-        for (unsigned int i = 0; i < children.size(); ++i) {
-            int simulations = children[i].simulations;
-            if (simulations > max_simulations) {
-                max_simulations = simulations;
-                max_index = i;
-            }
-        }
+void batch_playouts_scalar(PlayoutJob* jobs, int count, int lanes) {
+    BATCH_PLAYOUT_BODY
+}
+
+#ifdef HAVE_X86_KERNELS
+__attribute__((target("avx2")))
+void batch_playouts_avx2(PlayoutJob* jobs, int count, int lanes) {
+    BATCH_PLAYOUT_BODY
+}
+
+__attribute__((target("avx512f")))
+void batch_playouts_avx512(PlayoutJob* jobs, int count, int lanes) {
+    BATCH_PLAYOUT_BODY
+}
+#endif
+
+typedef void (*BatchKernel)(PlayoutJob* jobs, int count, int lanes);
 
-        return children[max_index];
+// The batched playout built for the same instruction set as move_kernel.
+BatchKernel batch_kernel() {
+#ifdef HAVE_X86_KERNELS
+    if (strcmp(move_kernel.name, "avx512") == 0) {
+        return batch_playouts_avx512;
+    } else if (strcmp(move_kernel.name, "avx2") == 0) {
+        return batch_playouts_avx2;
     }
+#endif
+    return batch_playouts_scalar;
+}
 
-    Board get_board() {
-        return board;
+// The eight symmetries of the board as bitboard transforms: bit 2 of sym
+// transposes along a1-h8, bit 1 flips the rows, bit 0 mirrors the columns.
+uint64_t flip_vertical(uint64_t x) {
+    return __builtin_bswap64(x);
+}
+
+uint64_t mirror_horizontal(uint64_t x) {
+    x = ((x >> 1) & 0x5555555555555555) | ((x & 0x5555555555555555) << 1);
+    x = ((x >> 2) & 0x3333333333333333) | ((x & 0x3333333333333333) << 2);
+    return ((x >> 4) & 0x0f0f0f0f0f0f0f0f) | ((x & 0x0f0f0f0f0f0f0f0f) << 4);
+}
+
+uint64_t flip_diagonal(uint64_t x) {
+    uint64_t t = 0x0f0f0f0f00000000 & (x ^ (x << 28));
+    x ^= t ^ (t >> 28);
+    t = 0x3333000033330000 & (x ^ (x << 14));
+    x ^= t ^ (t >> 14);
+    t = 0x5500550055005500 & (x ^ (x << 7));
+    return x ^ t ^ (t >> 7);
+}
+
+uint64_t transform(uint64_t x, int sym) {
+    if (sym & 4) {
+        x = flip_diagonal(x);
     }
 
-    Player get_turn() {
-        return turn;
+    if (sym & 2) {
+        x = flip_vertical(x);
     }
 
-    bool is_terminal() {
-        return terminal_position;
+    if (sym & 1) {
+        x = mirror_horizontal(x);
     }
 
-    double confidence() {
-        return (double) wins / simulations;
+    return x;
+}
+
+// n-tuple pattern evaluator. A pattern is a set of up to ten squares whose
+// contents, read as base-3 digits (empty, own, opponent), index a weight.
+// Every pattern is read from all eight symmetric views of the board, and
+// the weights of a game phase sit in one packed table. The sum of the
+// weights is the logit of the side to move winning.
+#define PATTERN_COUNT 10
+#define PATTERN_PHASES 4
+
+// Squares of each pattern, in the order gather() packs them.
+const uint64_t pattern_masks[PATTERN_COUNT] = {
+    0x0000000000070707, // 3x3 corner
+    0x0000000000001f1f, // 2x5 corner
+    0x00000000000042ff, // edge with both X squares
+    0x000000000000ff00, // second row
+    0x0000000000ff0000, // third row
+    0x00000000ff000000, // fourth row
+    0x8040201008040201, // main diagonal
+    0x0080402010080402, // diagonals of seven, six and five
+    0x0000804020100804,
+    0x0000008040201008,
+};
+
+class PatternEvaluator {
+private:
+    size_t offsets[PATTERN_COUNT];
+    size_t phase_size;
+    std::vector<float> weights;
+    uint16_t ternary[1 << 10]; // bits of a pattern to its base-3 index
+
+    // Packs the squares of every pattern into the low bits, lowest square
+    // first, as a PEXT by pattern_masks would but with shifts and one
+    // multiply per diagonal, so every target runs it at full speed.
+    static void gather(uint64_t x, uint64_t* bits) {
+        const uint64_t columns = 0x0101010101010101;
+        bits[0] = (x & 0x7) | ((x >> 5) & 0x38) | ((x >> 10) & 0x1c0);
+        bits[1] = (x & 0x1f) | ((x >> 3) & 0x3e0);
+        bits[2] = (x & 0xff) | ((x >> 1) & 0x100) | ((x >> 5) & 0x200);
+        bits[3] = (x >> 8) & 0xff;
+        bits[4] = (x >> 16) & 0xff;
+        bits[5] = (x >> 24) & 0xff;
+        bits[6] = ((x & pattern_masks[6]) * columns) >> 56;
+        bits[7] = ((x & pattern_masks[7]) * columns) >> 57;
+        bits[8] = ((x & pattern_masks[8]) * columns) >> 58;
+        bits[9] = ((x & pattern_masks[9]) * columns) >> 59;
+    }
+
+    static int phase(Board board) {
+        return std::min(PATTERN_PHASES - 1, (64 - board.occupied().bits_set()) / 16);
     }
 
-    Node& choose_move(Board move) {
-        for (Node& child : children) {
-            if (child.board == move) {
-                return child;
+    // Calls visit with the weight index of every pattern in every view.
+    template<typename Visit>
+    void for_each_feature(Board board, Player turn, Visit visit) const {
+        uint64_t own = board.disks(turn).get_bits();
+        uint64_t opp = board.disks(opponent(turn)).get_bits();
+        size_t base = phase(board) * phase_size;
+        for (int sym = 0; sym < 8; ++sym) {
+            uint64_t own_bits[PATTERN_COUNT];
+            uint64_t opp_bits[PATTERN_COUNT];
+            gather(transform(own, sym), own_bits);
+            gather(transform(opp, sym), opp_bits);
+            for (int i = 0; i < PATTERN_COUNT; ++i) {
+                visit(base + offsets[i] + ternary[own_bits[i]] + 2 * ternary[opp_bits[i]]);
             }
         }
-    
-        std::cout << "Error: move not detected";
-        return children[0];
     }
-};
 
-int main(void) {
-    srand(time(NULL));
-    
-    Board board = Board::opening_position();
-    for (;;) {
-        Node node(board, Player::dark);
-        for (int i = 0; i < 250000; ++i) {
-            node.mcts();
+public:
+    PatternEvaluator() {
+        phase_size = 0;
+        for (int i = 0; i < PATTERN_COUNT; ++i) {
+            offsets[i] = phase_size;
+            size_t states = 1;
+            for (int k = 0; k < __builtin_popcountll(pattern_masks[i]); ++k) {
+                states *= 3;
+            }
+
+            phase_size += states;
         }
-        
-        std::cout << "Confidence: " << node.confidence() << std::endl;
-        board = node.best_move().get_board();
-        board.display();
 
-        if (board.find_moves(Player::light).empty()) {
-            break;
+        for (int bits = 0; bits < (1 << 10); ++bits) {
+            int index = 0;
+            for (int k = 9; k >= 0; --k) {
+                index = index * 3 + ((bits >> k) & 1);
+            }
+
+            ternary[bits] = index;
         }
 
-        /*int x, y;
-        std::cin >> x;
-        std::cin >> y;
-        board = board.place_disk(Player::light, x, y)
-        board.display */
-        //std::vector<Board> moves = board.find_moves(Player::light);
-        //board = moves[rand() % moves.size()];
-        Node node2(board, Player::light);
-        for (int i = 0; i < 250000; ++i) {
-            node2.mcts();
+        weights.assign(phase_size * PATTERN_PHASES, 0.0f);
+    }
+
+    // Probability that turn wins from board.
+    double evaluate(Board board, Player turn) const {
+        float sum = 0;
+        for_each_feature(board, turn, [&](size_t index) {
+            sum += weights[index];
+        });
+
+        return 1 / (1 + exp(-sum));
+    }
+
+    // One logistic regression step towards target, the result for turn
+    // (1 win, 0.5 draw, 0 loss). Returns the squared error before the step.
+    double train(Board board, Player turn, double target, double rate) {
+        double error = target - evaluate(board, turn);
+        float step = rate * error;
+        for_each_feature(board, turn, [&](size_t index) {
+            weights[index] += step;
+        });
+
+        return error * error;
+    }
+
+    // Weight files are a magic and the raw table in host byte order.
+    bool load(const char* path) {
+        std::ifstream in(path, std::ios::binary);
+        char magic[8];
+        in.read(magic, sizeof(magic));
+        if (!in || memcmp(magic, "OTHPAT01", sizeof(magic)) != 0) {
+            return false;
         }
 
-        board = node2.best_move().get_board();
-        board.display();
+        std::vector<float> table(weights.size());
+        in.read((char*) table.data(), table.size() * sizeof(float));
+        if (!in || in.peek() != EOF) {
+            return false;
+        }
 
-        if (board.find_moves(Player::dark).empty()) {
-            break;
+        weights.swap(table);
+        return true;
+    }
+
+    bool save(const char* path) const {
+        std::ofstream out(path, std::ios::binary);
+        out.write("OTHPAT01", 8);
+        out.write((const char*) weights.data(), weights.size() * sizeof(float));
+        return (bool) out;
+    }
+};
+
+// Credit for turn, in WIN_UNIT parts of a win, from playing plies random
+// moves out of board and letting evaluator score where that ends. The
+// probability is rounded up or down at random in proportion, so that the
+// credit is unbiased.
+int evaluate_leaf(Board board, Player turn, int plies, const PatternEvaluator& evaluator) {
+    Player side = turn;
+    for (int ply = 0; ply < plies; ++ply) {
+        BitBoard moves = board.move_bits(side);
+        if (moves.is_empty()) {
+            int margin = board.disks(turn).bits_set() - board.disks(opponent(turn)).bits_set();
+            return margin > 0 ? WIN_UNIT : margin < 0 ? 0 : WIN_UNIT / 2;
         }
+
+        board = board.place_disk(side, moves.select_bit(rng.below(moves.bits_set())));
+        side = opponent(side);
     }
-    
+
+    double probability = evaluator.evaluate(board, side);
+    if (side != turn) {
+        probability = 1 - probability;
+    }
+
+    double scaled = probability * WIN_UNIT;
+    int credit = (int) scaled;
+    return credit + ((rng.next() >> 11) * 0x1.0p-53 < scaled - credit);
+}
+
+// Exact endgame search under this engine's rules: the game is over as soon
+// as the side to move has no legal move, and the result is the difference in
+// disks. Scores are from the side to move's point of view and the search is a
+// fail-soft alpha-beta negamax over raw bitboards. Not shared between threads.
+class EndgameSolver {
+private:
+    static constexpr uint64_t quadrants[4] = {
+        0x000000000f0f0f0f, 0x00000000f0f0f0f0, 0x0f0f0f0f00000000, 0xf0f0f0f000000000,
+    };
+
+    // Below this many empties move ordering is by parity alone; above it
+    // moves are sorted fastest-first by the opponent's reply count.
+    static const int ordering_empties = 6;
+
+    long nodes;
+
+    static uint64_t legal(uint64_t own, uint64_t opp) {
+        return move_kernel.kernel(own, opp) & ~(own | opp);
+    }
+
+    static int final_score(uint64_t own, uint64_t opp) {
+        return __builtin_popcountll(own) - __builtin_popcountll(opp);
+    }
+
+    // Our disks after playing index, or own unchanged if index is not legal.
+    // place_disk() does not check legality itself, so a move that flips
+    // nothing is rejected here.
+    static uint64_t play(uint64_t own, uint64_t opp, int index) {
+        Board after = Board(own, opp).place_disk(Player::dark, index);
+        if (after.disks(Player::light) == opp) {
+            return own;
+        }
+
+        return after.disks(Player::dark).get_bits();
+    }
+
+    // Squares in quadrants holding an odd number of empties.
+    static uint64_t odd_regions(uint64_t empty) {
+        uint64_t odd = 0;
+        for (uint64_t quadrant : quadrants) {
+            if (__builtin_popcountll(empty & quadrant) & 1) {
+                odd |= quadrant;
+            }
+        }
+
+        return odd;
+    }
+
+    // One empty square left: play it if we can, otherwise the game is over.
+    int last_one(uint64_t own, uint64_t opp, int index) {
+        ++nodes;
+        uint64_t after = play(own, opp, index);
+        if (after == own) {
+            return final_score(own, opp);
+        }
+
+        return final_score(after, opp & ~after);
+    }
+
+    // Two to four empty squares left, listed in squares in the order to try
+    // them. Each is played directly, so there is no move generation; a
+    // square that flips nothing is not a move.
+    int last_few(uint64_t own, uint64_t opp, const int* squares, int count, int alpha, int beta) {
+        ++nodes;
+        int best = -65;
+        for (int i = 0; i < count; ++i) {
+            uint64_t after = play(own, opp, squares[i]);
+            if (after == own) {
+                continue;
+            }
+
+            int rest[3];
+            for (int j = 0, k = 0; j < count; ++j) {
+                if (j != i) {
+                    rest[k++] = squares[j];
+                }
+            }
+
+            int score = count == 2
+                ? -last_one(opp & ~after, after, rest[0])
+                : -last_few(opp & ~after, after, rest, count - 1, -beta, -alpha);
+            if (score > best) {
+                best = score;
+                if (score > alpha) {
+                    alpha = score;
+                    if (alpha >= beta) {
+                        break;
+                    }
+                }
+            }
+        }
+
+        if (best == -65) {
+            return final_score(own, opp);
+        }
+
+        return best;
+    }
+
+    int search(uint64_t own, uint64_t opp, int alpha, int beta, int empties) {
+        uint64_t empty = ~(own | opp);
+        if (empties == 1) {
+            return last_one(own, opp, __builtin_ctzll(empty));
+        }
+
+        if (empties <= 4) {
+            int squares[4];
+            int count = 0;
+            uint64_t odd = odd_regions(empty);
+            for (uint64_t part : {empty & odd, empty & ~odd}) {
+                while (part != 0) {
+                    squares[count++] = __builtin_ctzll(part);
+                    part &= part - 1;
+                }
+            }
+
+            return last_few(own, opp, squares, count, alpha, beta);
+        }
+
+        ++nodes;
+        uint64_t moves = legal(own, opp);
+        if (moves == 0) {
+            return final_score(own, opp);
+        }
+
+        // One slot per square: some positions have more than 32 legal moves.
+        int order[64];
+        int count = 0;
+        uint64_t odd = odd_regions(empty);
+        if (empties <= ordering_empties) {
+            for (uint64_t part : {moves & odd, moves & ~odd}) {
+                while (part != 0) {
+                    order[count++] = __builtin_ctzll(part);
+                    part &= part - 1;
+                }
+            }
+        } else {
+            int keys[64];
+            for (uint64_t bits = moves; bits != 0; bits &= bits - 1) {
+                int index = __builtin_ctzll(bits);
+                uint64_t after = play(own, opp, index);
+                int replies = __builtin_popcountll(legal(opp & ~after, after));
+                int key = replies * 2 + (((odd >> index) & 1) ^ 1);
+
+                int i = count++;
+                while (i > 0 && keys[i - 1] > key) {
+                    keys[i] = keys[i - 1];
+                    order[i] = order[i - 1];
+                    --i;
+                }
+
+                keys[i] = key;
+                order[i] = index;
+            }
+        }
+
+        int best = -65;
+        for (int i = 0; i < count; ++i) {
+            uint64_t after = play(own, opp, order[i]);
+            int score = -search(opp & ~after, after, -beta, -alpha, empties - 1);
+            if (score > best) {
+                best = score;
+                if (score > alpha) {
+                    alpha = score;
+                    if (alpha >= beta) {
+                        break;
+                    }
+                }
+            }
+        }
+
+        return best;
+    }
+
+public:
+    EndgameSolver() : nodes(0) {}
+
+    // Exact final disk difference for turn, or a bound on it outside
+    // (alpha, beta).
+    int solve(Board board, Player turn, int alpha, int beta) {
+        uint64_t own = board.disks(turn).get_bits();
+        uint64_t opp = board.disks(opponent(turn)).get_bits();
+        int empties = 64 - __builtin_popcountll(own | opp);
+        if (empties == 0) {
+            return final_score(own, opp);
+        }
+
+        return search(own, opp, alpha, beta, empties);
+    }
+
+    // 1, 0 or -1 for a win, draw or loss for turn; a null window around zero
+    // is all the search needs for that.
+    int solve_outcome(Board board, Player turn) {
+        int score = solve(board, turn, -1, 1);
+        return (score > 0) - (score < 0);
+    }
+
+    long get_nodes() {
+        return nodes;
+    }
+};
+
+constexpr uint64_t EndgameSolver::quadrants[4];
+
+// Default number of empties at or below which the search solves positions
+// exactly instead of sampling them with playouts.
+#define SOLVE_EMPTIES 12
+
+// Zobrist keys: one per (player, square) plus one for the side to move,
+// generated from a fixed seed so hashes are stable between runs.
+struct Zobrist {
+    uint64_t squares[2][64];
+    uint64_t flips[64];
+    uint64_t side;
+
+    Zobrist() {
+        uint64_t state = 0x9e3779b97f4a7c15;
+        auto next = [&state]() {
+            return splitmix64(state);
+        };
+
+        for (int player = 0; player < 2; ++player) {
+            for (int square = 0; square < 64; ++square) {
+                squares[player][square] = next();
+            }
+        }
+
+        for (int square = 0; square < 64; ++square) {
+            flips[square] = squares[0][square] ^ squares[1][square];
+        }
+
+        side = next();
+    }
+};
+
+const Zobrist zobrist;
+
+uint64_t zobrist_hash(Board board, Player turn) {
+    uint64_t hash = turn == Player::light ? zobrist.side : 0;
+    for (int player = 0; player < 2; ++player) {
+        BitBoard disks = board.bits[player];
+        while (!disks.is_empty()) {
+            hash ^= zobrist.squares[player][disks.peel_bit()];
+        }
+    }
+
+    return hash;
+}
+
+// Hash of the position after player puts a disk on index and turns flipped,
+// given the hash of the position before.
+uint64_t zobrist_move(uint64_t hash, Player player, int index, BitBoard flipped) {
+    hash ^= zobrist.squares[static_cast<int>(player)][index] ^ zobrist.side;
+    while (!flipped.is_empty()) {
+        hash ^= zobrist.flips[flipped.peel_bit()];
+    }
+
+    return hash;
+}
+
+// Statistics for one position, shared by every node that reaches it. wins
+// counts wins for the side to move in WIN_UNIT parts, as in Node. The low
+// bits of the hash pick the bucket, so key only keeps the top half (see
+// TranspositionTable::tag()) and the entry stays 16 bytes with 64-bit wins.
+// A key of 0 marks a free slot.
+struct TTEntry {
+    std::atomic<uint32_t> key;
+    std::atomic<int> simulations;
+    std::atomic<int64_t> wins;
+};
+
+struct alignas(64) TTBucket {
+    TTEntry entries[4];
+};
+
+// Fixed-size table of cache-line buckets indexed by the low bits of the
+// Zobrist hash. A position missing from its bucket takes over the entry with
+// the fewest simulations, so memory use never grows past the initial size.
+class TranspositionTable {
+private:
+    TTBucket* buckets;
+    size_t mask;
+    std::atomic<long> probes;
+    std::atomic<long> hits;
+
+public:
+    TranspositionTable(size_t megabytes) : probes(0), hits(0) {
+        size_t count = 1;
+        while (count * 2 * sizeof(TTBucket) <= megabytes << 20) {
+            count *= 2;
+        }
+
+        buckets = new TTBucket[count]();
+        mask = count - 1;
+    }
+
+    ~TranspositionTable() {
+        delete[] buckets;
+    }
+
+    TranspositionTable(const TranspositionTable&) = delete;
+    TranspositionTable& operator=(const TranspositionTable&) = delete;
+
+    // What an entry keeps of hash to recognise it; never 0.
+    static uint32_t tag(uint64_t hash) {
+        return (uint32_t) (hash >> 32) | 1;
+    }
+
+    // The entry for hash, claiming a slot for it if it is not in the table.
+    // Concurrent claims of one slot can mix statistics for an iteration or
+    // two, which the search tolerates.
+    TTEntry* probe(uint64_t hash) {
+        TTBucket& bucket = buckets[hash & mask];
+        uint32_t key = tag(hash);
+        probes.fetch_add(1, std::memory_order_relaxed);
+
+        TTEntry* victim = &bucket.entries[0];
+        int fewest = INT_MAX;
+        for (TTEntry& entry : bucket.entries) {
+            uint32_t stored = entry.key.load(std::memory_order_relaxed);
+            if (stored == key) {
+                hits.fetch_add(1, std::memory_order_relaxed);
+                return &entry;
+            }
+
+            int simulations = stored == 0 ? -1 : entry.simulations.load(std::memory_order_relaxed);
+            if (simulations < fewest) {
+                fewest = simulations;
+                victim = &entry;
+            }
+        }
+
+        victim->wins.store(0, std::memory_order_relaxed);
+        victim->simulations.store(0, std::memory_order_relaxed);
+        victim->key.store(key, std::memory_order_relaxed);
+        return victim;
+    }
+
+    double hit_rate() {
+        long total = probes.load(std::memory_order_relaxed);
+        return total == 0 ? 0 : (double) hits.load(std::memory_order_relaxed) / total;
+    }
+
+    size_t bytes() {
+        return (mask + 1) * sizeof(TTBucket);
+    }
+};
+
+typedef std::chrono::steady_clock::time_point Deadline;
+
+// Wall-clock deadline checks are amortised over this many iterations per thread.
+#define CLOCK_CHECK_INTERVAL 32
+
+// Hot-path counters, only updated in builds compiled with -DSEARCH_STATS so
+// that normal builds pay nothing for them. Each search thread fills its own
+// copy and the copies are summed when the search ends. Times are in
+// nanoseconds and overlap nothing: selection, expansion and solving, the
+// playouts themselves and the backpropagation of results.
+struct SearchStats {
+    long expansions;
+    long solves;
+    long playouts;
+    long terminal_hits;
+    long depth_total;
+    long select_ns;
+    long expand_ns;
+    long solve_ns;
+    long playout_ns;
+    long backprop_ns;
+
+    void merge(const SearchStats& other) {
+        expansions += other.expansions;
+        solves += other.solves;
+        playouts += other.playouts;
+        terminal_hits += other.terminal_hits;
+        depth_total += other.depth_total;
+        select_ns += other.select_ns;
+        expand_ns += other.expand_ns;
+        solve_ns += other.solve_ns;
+        playout_ns += other.playout_ns;
+        backprop_ns += other.backprop_ns;
+    }
+};
+
+thread_local SearchStats search_stats;
+
+#ifdef SEARCH_STATS
+// Adds the lifetime of the enclosing scope to a SearchStats time field.
+class StatTimer {
+private:
+    long& total;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    StatTimer(long& total) : total(total), start(std::chrono::steady_clock::now()) {}
+
+    ~StatTimer() {
+        total += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+#define STAT_ADD(FIELD, N) (search_stats.FIELD += (N))
+#define STAT_TIME(FIELD) StatTimer stat_timer_##FIELD(search_stats.FIELD)
+#else
+#define STAT_ADD(FIELD, N) ((void) 0)
+#define STAT_TIME(FIELD) ((void) 0)
+#endif
+
+struct SearchResult {
+    long iterations;
+    double seconds;
+    int max_depth;
+    SearchStats stats;
+};
+
+// Bump allocator handing out contiguous runs of T from large blocks. Blocks
+// are kept across reset(), so clearing a whole tree between moves is O(1)
+// and steady-state search does no heap allocation at all. T must be
+// trivially destructible since nothing is ever destroyed individually.
+template <typename T>
+class Arena {
+private:
+    static const size_t block_size = 1 << 16;
+    static const size_t max_blocks = 1 << 14;
+
+    std::atomic<size_t> next;
+    // 128 KB of block pointers; kept on the heap because trees, and the
+    // arenas inside them, often live on thread stacks.
+    std::unique_ptr<std::atomic<T*>[]> blocks;
+    std::mutex grow;
+
+    T* block(size_t index) {
+        T* existing = blocks[index].load(std::memory_order_acquire);
+        if (existing != nullptr) {
+            return existing;
+        }
+
+        std::lock_guard<std::mutex> lock(grow);
+        existing = blocks[index].load(std::memory_order_relaxed);
+        if (existing == nullptr) {
+            // Blocks are mapped directly so that release() really returns
+            // them to the system.
+            void* memory = mmap(nullptr, block_size * sizeof(T), PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (memory == MAP_FAILED) {
+                std::cout << "Error: out of memory for the node arena" << std::endl;
+                std::abort();
+            }
+
+            existing = static_cast<T*>(memory);
+            blocks[index].store(existing, std::memory_order_release);
+        }
+
+        return existing;
+    }
+public:
+    Arena() : next(0), blocks(new std::atomic<T*>[max_blocks]) {
+        for (size_t i = 0; i < max_blocks; ++i) {
+            blocks[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ~Arena() {
+        release();
+    }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // Uninitialised storage for count objects; a run never straddles two
+    // blocks, the tail of a block is skipped instead.
+    T* allocate(size_t count) {
+        for (;;) {
+            size_t start = next.fetch_add(count, std::memory_order_relaxed);
+            size_t offset = start % block_size;
+            if (offset + count > block_size) {
+                continue;
+            }
+
+            size_t index = start / block_size;
+            if (index >= max_blocks) {
+                std::cout << "Error: node arena exhausted" << std::endl;
+                std::abort();
+            }
+
+            return block(index) + offset;
+        }
+    }
+
+    void reset() {
+        next.store(0, std::memory_order_relaxed);
+    }
+
+    // Empties the arena and hands its blocks back; nothing may point into
+    // it any more.
+    void release() {
+        reset();
+        for (size_t i = 0; i < max_blocks && blocks[i].load(std::memory_order_relaxed) != nullptr; ++i) {
+            munmap(blocks[i].load(std::memory_order_relaxed), block_size * sizeof(T));
+            blocks[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    size_t size() {
+        return next.load(std::memory_order_relaxed);
+    }
+
+    size_t bytes() {
+        return size() * sizeof(T);
+    }
+
+    // Memory actually held, including blocks kept from earlier trees.
+    size_t reserved_bytes() {
+        size_t count = 0;
+        for (size_t i = 0; i < max_blocks && blocks[i].load(std::memory_order_relaxed) != nullptr; ++i) {
+            ++count;
+        }
+
+        return count * block_size * sizeof(T);
+    }
+};
+
+class Node;
+
+#define SLOT_LANES 4 // one SSE register of floats
+
+// Statistics of up to SLOT_LANES children, one lane each, kept beside the
+// parent so that select() scores a whole group without touching the child
+// nodes. The parent copies a child's counts into its lane after every
+// backup; pending counts the descents still in flight through the child.
+struct alignas(32) SlotGroup {
+    std::atomic<int> visits[SLOT_LANES];      // the child's own simulations
+    std::atomic<float> mean_wins[SLOT_LANES]; // what its mean is taken from,
+    std::atomic<int> mean_visits[SLOT_LANES]; // possibly a transposition
+    std::atomic<int> pending[SLOT_LANES];
+    std::atomic<Node*> nodes[SLOT_LANES];     // null until first selected
+
+    SlotGroup() {
+        for (int lane = 0; lane < SLOT_LANES; ++lane) {
+            visits[lane].store(0, std::memory_order_relaxed);
+            mean_wins[lane].store(0.0f, std::memory_order_relaxed);
+            mean_visits[lane].store(0, std::memory_order_relaxed);
+            pending[lane].store(0, std::memory_order_relaxed);
+            nodes[lane].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    // Copies the statistics with nothing in flight; nodes still point into
+    // the source arena. Not safe while a search is running.
+    SlotGroup(const SlotGroup& other) : SlotGroup() {
+        for (int lane = 0; lane < SLOT_LANES; ++lane) {
+            visits[lane].store(other.visits[lane].load(std::memory_order_relaxed), std::memory_order_relaxed);
+            mean_wins[lane].store(other.mean_wins[lane].load(std::memory_order_relaxed), std::memory_order_relaxed);
+            mean_visits[lane].store(other.mean_visits[lane].load(std::memory_order_relaxed),
+                                    std::memory_order_relaxed);
+            nodes[lane].store(other.nodes[lane].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+    }
+};
+
+// Everything a search needs besides the tree itself.
+struct SearchContext {
+    Arena<Node>* arena;
+    Arena<SlotGroup>* slots;
+    TranspositionTable* table; // null when transpositions are not shared
+    int batch;                 // lanes per leaf-parallel iteration, 0 to disable
+    int solve_empties;         // solve exactly at or below this many empties
+    uint64_t seed;             // worker i draws from stream i of this seed
+    const std::atomic<bool>* stop; // ends the search once set, may be null
+    double exploration;        // UCT exploration constant
+    const PatternEvaluator* evaluator; // scores leaves instead of playouts, may be null
+    int eval_plies;            // random plies before the evaluator scores a leaf
+    size_t memory_limit;       // tree bytes at which the search pauses, 0 for none
+};
+
+class Node {
+private:
+    enum Expansion {
+        unexpanded = 0,
+        expanding = 1,
+        expanded = 2,
+    };
+
+    Board board;
+    Player turn;
+    std::atomic<int> simulations;
+    uint64_t hash;
+    std::atomic<int64_t> wins;
+    std::atomic<TTEntry*> entry;
+    std::atomic<int> expansion;
+    uint64_t moves;      // legal moves, one slot each in ascending square order
+    SlotGroup* slots;    // ceil(slot_count / SLOT_LANES) groups, null without moves
+    int slot_count;
+    bool terminal_position;
+    bool solved; // terminal only because the endgame solver settled it
+    int outcome; // sign of the final disk difference for turn, once terminal
+
+    SlotGroup& group(int slot) {
+        return slots[slot / SLOT_LANES];
+    }
+
+    std::atomic<int>& slot_pending(int slot) {
+        return group(slot).pending[slot % SLOT_LANES];
+    }
+
+    // Adds one simulation's result, win being the part of WIN_UNIT that turn
+    // scored in it.
+    void record(int win, TranspositionTable* table) {
+        STAT_TIME(backprop_ns);
+        wins.fetch_add(win, std::memory_order_relaxed);
+        simulations.fetch_add(1, std::memory_order_relaxed);
+
+        if (table != nullptr) {
+            TTEntry* shared = entry.load(std::memory_order_relaxed);
+            if (shared == nullptr || shared->key.load(std::memory_order_relaxed) != TranspositionTable::tag(hash)) {
+                shared = table->probe(hash);
+                entry.store(shared, std::memory_order_relaxed);
+            }
+
+            shared->wins.fetch_add(win, std::memory_order_relaxed);
+            shared->simulations.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Copies child's statistics into its slot once it has been backed up.
+    // The mean comes from the transposition entry when that has seen more of
+    // the position than the child itself.
+    void publish(int slot, Node& child) {
+        int child_simulations = child.simulations.load(std::memory_order_relaxed);
+        int mean_simulations = child_simulations;
+        int64_t mean_wins = child.wins.load(std::memory_order_relaxed);
+        TTEntry* shared = child.entry.load(std::memory_order_relaxed);
+        if (shared != nullptr && shared->key.load(std::memory_order_relaxed) == TranspositionTable::tag(child.hash)) {
+            int shared_simulations = shared->simulations.load(std::memory_order_relaxed);
+            if (shared_simulations > child_simulations) {
+                mean_simulations = shared_simulations;
+                mean_wins = shared->wins.load(std::memory_order_relaxed);
+            }
+        }
+
+        SlotGroup& stats = group(slot);
+        int lane = slot % SLOT_LANES;
+        stats.visits[lane].store(child_simulations, std::memory_order_relaxed);
+        stats.mean_wins[lane].store((float) mean_wins, std::memory_order_relaxed);
+        stats.mean_visits[lane].store(mean_simulations, std::memory_order_relaxed);
+    }
+
+    // The child for slot, built the first time it is asked for. Threads that
+    // race to build it keep whichever node was linked first; the loser's
+    // copy is left unused in the arena.
+    Node& materialize(int slot, SearchContext& context) {
+        std::atomic<Node*>& link = group(slot).nodes[slot % SLOT_LANES];
+        Node* node = link.load(std::memory_order_acquire);
+        if (node != nullptr) {
+            return *node;
+        }
+
+        uint64_t remaining = moves;
+        for (int i = 0; i < slot; ++i) {
+            remaining &= remaining - 1;
+        }
+
+        int index = __builtin_ctzll(remaining);
+        Board child = board.place_disk(turn, index);
+        BitBoard flipped = board.disks(opponent(turn)) ^ child.disks(opponent(turn));
+        Node* fresh = new (context.arena->allocate(1))
+            Node(child, opponent(turn), zobrist_move(hash, turn, index, flipped));
+        if (link.compare_exchange_strong(node, fresh, std::memory_order_acq_rel, std::memory_order_acquire)) {
+            return *fresh;
+        }
+
+        return *node;
+    }
+
+    // The slot with the best UCT value, the lowest on ties, so unvisited
+    // moves are tried in square order. The log term is taken once per call;
+    // each descent still in flight through a child counts as VIRTUAL_LOSS
+    // losses for this node.
+    int select(SearchContext& context) {
+        STAT_TIME(select_ns);
+        float scale = context.exploration * sqrt(log(simulations.load(std::memory_order_relaxed) + 1));
+
+#if defined(__SSE2__) && !defined(__SANITIZE_THREAD__)
+        // A group at a time. The loads read the atomics directly: each
+        // aligned lane is read whole on x86, which is all select() needs,
+        // but ThreadSanitizer cannot tell, so it gets the scalar loop.
+        const __m128 unit = _mm_set1_ps(WIN_UNIT);
+        const __m128 loss = _mm_set1_ps(VIRTUAL_LOSS);
+        const __m128 epsilon = _mm_set1_ps(EPSILON);
+        const __m128 weight = _mm_set1_ps(scale);
+        const __m128 lowest = _mm_set1_ps(-INFINITY);
+        const __m128i count = _mm_set1_epi32(slot_count);
+        const __m128i step = _mm_set1_epi32(SLOT_LANES);
+        __m128i slot = _mm_setr_epi32(0, 1, 2, 3);
+        __m128 best_values = lowest;
+        __m128i best_slots = _mm_setzero_si128();
+        for (int i = 0; i * SLOT_LANES < slot_count; ++i) {
+            SlotGroup& stats = slots[i];
+            __m128 visits = _mm_cvtepi32_ps(_mm_load_si128((const __m128i*) stats.visits));
+            __m128 mean_wins = _mm_load_ps((const float*) stats.mean_wins);
+            __m128 mean_visits = _mm_cvtepi32_ps(_mm_load_si128((const __m128i*) stats.mean_visits));
+            __m128 virtual_loss = _mm_mul_ps(loss, _mm_cvtepi32_ps(_mm_load_si128((const __m128i*) stats.pending)));
+
+            __m128 mean = _mm_div_ps(_mm_sub_ps(_mm_mul_ps(mean_visits, unit), mean_wins),
+                                     _mm_mul_ps(unit, _mm_add_ps(_mm_add_ps(mean_visits, virtual_loss), epsilon)));
+            __m128 explore = _mm_div_ps(weight, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(visits, virtual_loss), epsilon)));
+            __m128 value = _mm_add_ps(mean, explore);
+
+            // Lanes past the last move never win.
+            __m128 valid = _mm_castsi128_ps(_mm_cmplt_epi32(slot, count));
+            value = _mm_or_ps(_mm_and_ps(valid, value), _mm_andnot_ps(valid, lowest));
+
+            __m128 better = _mm_cmpgt_ps(value, best_values);
+            best_values = _mm_or_ps(_mm_and_ps(better, value), _mm_andnot_ps(better, best_values));
+            __m128i taken = _mm_castps_si128(better);
+            best_slots = _mm_or_si128(_mm_and_si128(taken, slot), _mm_andnot_si128(taken, best_slots));
+            slot = _mm_add_epi32(slot, step);
+        }
+
+        alignas(16) float values[4];
+        alignas(16) int candidates[4];
+        _mm_store_ps(values, best_values);
+        _mm_store_si128((__m128i*) candidates, best_slots);
+        int best = candidates[0];
+        float max_value = values[0];
+        for (int i = 1; i < 4; ++i) {
+            if (values[i] > max_value || (values[i] == max_value && candidates[i] < best)) {
+                max_value = values[i];
+                best = candidates[i];
+            }
+        }
+
+        return best;
+#else
+        int best = 0;
+        float max_value = -INFINITY;
+        for (int slot = 0; slot < slot_count; ++slot) {
+            SlotGroup& stats = group(slot);
+            int lane = slot % SLOT_LANES;
+            float visits = stats.visits[lane].load(std::memory_order_relaxed);
+            float mean_wins = stats.mean_wins[lane].load(std::memory_order_relaxed);
+            float mean_visits = stats.mean_visits[lane].load(std::memory_order_relaxed);
+            float virtual_loss = stats.pending[lane].load(std::memory_order_relaxed) * VIRTUAL_LOSS;
+
+            float mean = (mean_visits * WIN_UNIT - mean_wins)
+                         / (WIN_UNIT * (mean_visits + virtual_loss + (float) EPSILON));
+            float value = mean + scale / std::sqrt(visits + virtual_loss + (float) EPSILON);
+            if (value > max_value) {
+                max_value = value;
+                best = slot;
+            }
+        }
+
+        return best;
+#endif
+    }
+
+    // Only one thread expands a node; the others wait for it to publish it.
+    void ensure_expanded(SearchContext& context) {
+        if (expansion.load(std::memory_order_acquire) == expanded) {
+            return;
+        }
+
+        int expected = unexpanded;
+        if (expansion.compare_exchange_strong(expected, expanding, std::memory_order_acquire)) {
+            expand(context);
+            expansion.store(expanded, std::memory_order_release);
+            return;
+        }
+
+        while (expansion.load(std::memory_order_acquire) != expanded) {
+            std::this_thread::yield();
+        }
+    }
+
+    int empties() {
+        return 64 - board.occupied().bits_set();
+    }
+
+    // Positions within the solver's reach are settled once, exactly, and
+    // then behave like finished games.
+    bool solvable(SearchContext& context) {
+        return empties() <= context.solve_empties;
+    }
+
+    void expand(SearchContext& context) {
+        if (solvable(context)) {
+            STAT_TIME(solve_ns);
+            STAT_ADD(solves, 1);
+            EndgameSolver solver;
+            outcome = solver.solve_outcome(board, turn);
+            terminal_position = true;
+            solved = true;
+            return;
+        }
+
+        STAT_TIME(expand_ns);
+        BitBoard legal = board.move_bits(turn);
+        if (legal.is_empty()) {
+            int margin = board.score(turn) - board.score(opponent(turn));
+            outcome = (margin > 0) - (margin < 0);
+            terminal_position = true;
+            return;
+        }
+
+        // Only the slots are set up here; children are built when select()
+        // first picks them.
+        STAT_ADD(expansions, 1);
+        moves = legal.get_bits();
+        slot_count = legal.bits_set();
+        int groups = (slot_count + SLOT_LANES - 1) / SLOT_LANES;
+        SlotGroup* storage = context.slots->allocate(groups);
+        for (int i = 0; i < groups; ++i) {
+            new (storage + i) SlotGroup();
+        }
+
+        slots = storage;
+    }
+
+    // Credit for turn from a random playout, or from the pattern evaluator
+    // when the search has one.
+    int simulate(SearchContext& context) {
+        STAT_TIME(playout_ns);
+        STAT_ADD(playouts, 1);
+        if (context.evaluator != nullptr) {
+            return evaluate_leaf(board, turn, context.eval_plies, *context.evaluator);
+        }
+
+        return ::playout(board, turn) == turn ? WIN_UNIT : 0;
+    }
+public:
+    Node(Board board, Player turn, uint64_t hash)
+        : board(board), turn(turn), simulations(0), hash(hash), wins(0), entry(nullptr),
+          expansion(unexpanded), moves(0), slots(nullptr), slot_count(0), terminal_position(false),
+          solved(false), outcome(0) {}
+
+    Node(Board board, Player turn) : Node(board, turn, zobrist_hash(board, turn)) {}
+
+    // Copies the statistics only; the slots still live in the source arena
+    // until adopt_subtree() is called. Not safe while a search is running.
+    Node(const Node& other)
+        : board(other.board), turn(other.turn), simulations(other.simulations.load(std::memory_order_relaxed)),
+          hash(other.hash), wins(other.wins.load(std::memory_order_relaxed)),
+          entry(other.entry.load(std::memory_order_relaxed)),
+          expansion(other.expansion.load(std::memory_order_relaxed)),
+          moves(other.moves), slots(other.slots), slot_count(other.slot_count),
+          terminal_position(other.terminal_position), solved(other.solved), outcome(other.outcome) {}
+
+    // A node the solver settled has no children to choose a move from, so
+    // before it becomes a root it goes back to being unexpanded, keeping its
+    // statistics.
+    void reopen() {
+        if (solved) {
+            solved = false;
+            terminal_position = false;
+            expansion.store(unexpanded, std::memory_order_relaxed);
+        }
+    }
+
+    // Adds what the children and slots of this node and of each descendant
+    // take to bytes[b], b being the bit length of the visits of the node
+    // they hang from.
+    void tally(size_t bytes[33]) {
+        if (slots == nullptr) {
+            return;
+        }
+
+        size_t own = (slot_count + SLOT_LANES - 1) / SLOT_LANES * sizeof(SlotGroup);
+        for (int slot = 0; slot < slot_count; ++slot) {
+            Node* node = child(slot);
+            if (node != nullptr) {
+                own += sizeof(Node);
+                node->tally(bytes);
+            }
+        }
+
+        int visits = get_simulations();
+        bytes[visits > 0 ? 32 - __builtin_clz(visits) : 0] += own;
+    }
+
+    // Deep-copies the slots and every descendant into the given arenas so
+    // the source arenas can be reset. Nodes with fewer than min_visits
+    // simulations keep their statistics but lose their children, and are
+    // expanded again when next reached.
+    void adopt_subtree(Arena<Node>& arena, Arena<SlotGroup>& groups, int min_visits) {
+        if (slots == nullptr) {
+            return;
+        }
+
+        if (get_simulations() < min_visits) {
+            expansion.store(unexpanded, std::memory_order_relaxed);
+            moves = 0;
+            slots = nullptr;
+            slot_count = 0;
+            return;
+        }
+
+        int count = (slot_count + SLOT_LANES - 1) / SLOT_LANES;
+        SlotGroup* copy = groups.allocate(count);
+        for (int i = 0; i < count; ++i) {
+            new (copy + i) SlotGroup(slots[i]);
+            for (int lane = 0; lane < SLOT_LANES; ++lane) {
+                Node* child = copy[i].nodes[lane].load(std::memory_order_relaxed);
+                if (child != nullptr) {
+                    Node* adopted = new (arena.allocate(1)) Node(*child);
+                    adopted->adopt_subtree(arena, groups, min_visits);
+                    copy[i].nodes[lane].store(adopted, std::memory_order_relaxed);
+                }
+            }
+        }
+
+        slots = copy;
+    }
+
+    // Safe to call from several threads at once on the same root. Each
+    // descent marks the chosen slot as pending, which select() counts as a
+    // virtual loss so that concurrent workers spread across the tree.
+    // depth is incremented once for every ply descended below this node.
+    int mcts(SearchContext& context, int& depth) {
+        ensure_expanded(context);
+
+        if (terminal_position) {
+            STAT_ADD(terminal_hits, 1);
+            int win;
+            if (outcome != 0) {
+                win = outcome > 0 ? WIN_UNIT : 0;
+            } else {
+                win = rng.coin() * WIN_UNIT;
+            }
+
+            record(win, context.table);
+            return win;
+        }
+
+        int slot = select(context);
+        Node& next = materialize(slot, context);
+        depth += 1;
+        int in_flight = slot_pending(slot).fetch_add(1, std::memory_order_relaxed);
+        int visits = next.simulations.load(std::memory_order_relaxed);
+
+        int win;
+        if (visits == 0 && in_flight == 0 && !next.solvable(context)) {
+            int credit = next.simulate(context);
+            next.record(credit, context.table);
+            win = WIN_UNIT - credit;
+        } else {
+            win = WIN_UNIT - next.mcts(context, depth);
+        }
+
+        publish(slot, next);
+        slot_pending(slot).fetch_sub(1, std::memory_order_relaxed);
+        record(win, context.table);
+        return win;
+    }
+
+    // Leaf-parallel iteration: descends lanes times from this node, queues
+    // every new leaf, scores the whole queue with one batched playout and
+    // then backs each path up. The slots left pending along each path keep
+    // the descents apart. Returns the number of simulations added.
+    int mcts_batch(SearchContext& context, int& depth) {
+        int lanes = context.batch;
+        Node* paths[MAX_BATCH][64];
+        int taken[MAX_BATCH][64]; // the slot of paths[lane][i] in its parent
+        int lengths[MAX_BATCH];
+        Player winners[MAX_BATCH];
+        int queued[MAX_BATCH];
+        PlayoutJob jobs[MAX_BATCH];
+        int job_count = 0;
+
+        for (int lane = 0; lane < lanes; ++lane) {
+            Node* node = this;
+            int length = 0;
+            paths[lane][length++] = node;
+            queued[lane] = -1;
+
+            for (;;) {
+                node->ensure_expanded(context);
+                if (node->terminal_position) {
+                    STAT_ADD(terminal_hits, 1);
+                    if (node->outcome != 0) {
+                        winners[lane] = node->outcome > 0 ? node->turn : opponent(node->turn);
+                    } else {
+                        winners[lane] = static_cast<Player>(rng.coin());
+                    }
+                    break;
+                }
+
+                int slot = node->select(context);
+                Node& next = node->materialize(slot, context);
+                int in_flight = node->slot_pending(slot).fetch_add(1, std::memory_order_relaxed);
+                int visits = next.simulations.load(std::memory_order_relaxed);
+                taken[lane][length] = slot;
+                paths[lane][length++] = &next;
+                if (visits == 0 && in_flight == 0 && !next.solvable(context)) {
+                    jobs[job_count] = PlayoutJob{next.board, next.turn, Player::dark};
+                    queued[lane] = job_count++;
+                    break;
+                }
+
+                node = &next;
+            }
+
+            lengths[lane] = length;
+            depth = std::max(depth, length - 1);
+            STAT_ADD(depth_total, length - 1);
+        }
+
+        // With an evaluator the leaves are scored one by one and the credit
+        // belongs to the leaf's side to move; otherwise whoever won the
+        // playout gets the whole win.
+        int credits[MAX_BATCH];
+        if (context.evaluator != nullptr) {
+            STAT_TIME(playout_ns);
+            STAT_ADD(playouts, job_count);
+            for (int job = 0; job < job_count; ++job) {
+                credits[job] = evaluate_leaf(jobs[job].board, jobs[job].turn, context.eval_plies, *context.evaluator);
+            }
+        } else {
+            STAT_TIME(playout_ns);
+            STAT_ADD(playouts, job_count);
+            batch_kernel()(jobs, job_count, lanes);
+        }
+
+        for (int lane = 0; lane < lanes; ++lane) {
+            Player owner = winners[lane];
+            int credit = WIN_UNIT;
+            if (queued[lane] >= 0) {
+                PlayoutJob& job = jobs[queued[lane]];
+                owner = context.evaluator != nullptr ? job.turn : job.winner;
+                credit = context.evaluator != nullptr ? credits[queued[lane]] : WIN_UNIT;
+            }
+
+            for (int i = 0; i < lengths[lane]; ++i) {
+                Node* node = paths[lane][i];
+                node->record(node->turn == owner ? credit : WIN_UNIT - credit, context.table);
+                if (i > 0) {
+                    Node* parent = paths[lane][i - 1];
+                    parent->publish(taken[lane][i], *node);
+                    parent->slot_pending(taken[lane][i]).fetch_sub(1, std::memory_order_relaxed);
+                }
+            }
+        }
+
+        return lanes;
+    }
+
+    // Runs up to the given number of iterations spread over the given number
+    // of threads, the calling thread included, stopping early once deadline
+    // passes. iterations <= 0 means no iteration limit.
+    SearchResult search(SearchContext& context, long iterations, int threads, Deadline deadline) {
+        // The root itself is never handed to the solver: a move still has
+        // to be picked from its children.
+        SearchContext root_context = context;
+        root_context.solve_empties = 0;
+        ensure_expanded(root_context);
+
+        // The root gets every child up front, so a move can be picked and
+        // reported even when the search is stopped at once.
+        for (int slot = 0; slot < slot_count; ++slot) {
+            materialize(slot, context);
+        }
+
+        std::atomic<long> remaining(iterations > 0 ? iterations : LONG_MAX);
+        std::atomic<long> done(0);
+        std::atomic<int> max_depth(0);
+        bool timed = deadline != Deadline::max();
+        SearchStats stats = {};
+        std::mutex stats_lock;
+
+        int batch = context.batch;
+        int step = batch > 0 ? batch : 1;
+        auto worker = [&](int index) {
+            rng.seed(context.seed, index);
+            long count = 0;
+            long steps = 0;
+            int deepest = 0;
+            search_stats = SearchStats{};
+            while (remaining.fetch_sub(step, std::memory_order_relaxed) > 0) {
+                if (context.stop != nullptr && context.stop->load(std::memory_order_relaxed)) {
+                    break;
+                }
+
+                if (timed && steps % CLOCK_CHECK_INTERVAL == 0
+                        && std::chrono::steady_clock::now() >= deadline) {
+                    break;
+                }
+
+                // A full tree pauses the search so that it can be pruned.
+                if (context.memory_limit > 0 && steps % CLOCK_CHECK_INTERVAL == 0
+                        && context.arena->bytes() + context.slots->bytes() >= context.memory_limit) {
+                    break;
+                }
+
+                int depth = 0;
+                if (batch > 0) {
+                    count += mcts_batch(context, depth);
+                } else {
+                    mcts(context, depth);
+                    STAT_ADD(depth_total, depth);
+                    ++count;
+                }
+
+                deepest = std::max(deepest, depth);
+                ++steps;
+            }
+
+            done.fetch_add(count, std::memory_order_relaxed);
+            int seen = max_depth.load(std::memory_order_relaxed);
+            while (seen < deepest && !max_depth.compare_exchange_weak(seen, deepest)) {}
+
+            std::lock_guard<std::mutex> lock(stats_lock);
+            stats.merge(search_stats);
+        };
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for (int i = 1; i < threads; ++i) {
+            workers.emplace_back(worker, i);
+        }
+
+        worker(0);
+        for (std::thread& t : workers) {
+            t.join();
+        }
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return SearchResult{done.load(), elapsed.count(), max_depth.load(), stats};
+    }
+
+    // The most visited child, the lowest square on ties.
+    Node& best_move() {
+        Node* best = nullptr;
+        int max_simulations = -1;
+        for (int slot = 0; slot < child_count(); ++slot) {
+            Node* node = child(slot);
+            if (node != nullptr && node->get_simulations() > max_simulations) {
+                max_simulations = node->get_simulations();
+                best = node;
+            }
+        }
+
+        return *best;
+    }
+
+    Board get_board() {
+        return board;
+    }
+
+    Player get_turn() {
+        return turn;
+    }
+
+    bool is_terminal() {
+        return terminal_position;
+    }
+
+    int get_simulations() {
+        return simulations.load(std::memory_order_relaxed);
+    }
+
+    // Credit for turn over all simulations, in units of WIN_UNIT.
+    int64_t get_wins() {
+        return wins.load(std::memory_order_relaxed);
+    }
+
+    // One slot per legal move, zero until the node is expanded. Safe to call
+    // during a search.
+    int child_count() {
+        return expansion.load(std::memory_order_acquire) == expanded ? slot_count : 0;
+    }
+
+    // The child for slot, slots running in ascending square order, or
+    // nullptr while it has not been built.
+    Node* child(int slot) {
+        return group(slot).nodes[slot % SLOT_LANES].load(std::memory_order_acquire);
+    }
+
+    double confidence() {
+        return (double) wins / ((double) simulations * WIN_UNIT);
+    }
+
+    // The child reached by playing move, or nullptr if it was never expanded.
+    Node* choose_move(Board move) {
+        for (int slot = 0; slot < child_count(); ++slot) {
+            Node* node = child(slot);
+            if (node != nullptr && node->board == move) {
+                return node;
+            }
+        }
+
+        return nullptr;
+    }
+};
+
+// A search tree kept alive across moves. The root always lives in the
+// current arenas; advance() copies the subtree under the move actually played
+// into the spare arenas and resets the old ones, so statistics gathered under
+// that move carry over to the next search.
+//
+// Under a memory limit the live tree may take two thirds of it. A search
+// that fills that much pauses, the tree is copied into the spare arenas
+// without the children of its least visited nodes until it fits in a third,
+// and the search resumes there. The old arenas give their blocks back, so
+// both pairs together stay close to the limit.
+class Tree {
+private:
+    Arena<Node> arenas[2];
+    Arena<SlotGroup> slot_arenas[2];
+    int current;
+    Node* root;
+    std::unique_ptr<TranspositionTable> table;
+    uint64_t seed;
+    uint64_t searches;
+    const PatternEvaluator* evaluator;
+    int eval_plies;
+    size_t memory_limit; // bytes for both arena pairs, 0 for no limit
+    long compactions;
+    std::mutex layout;   // held while the tree moves between arenas
+
+    // Pondering: a background search of the root while the opponent thinks.
+    // ponder_base holds each root child's visits when it started, so that
+    // advance() can tell how much of the played line pondering built.
+    std::thread ponderer;
+    std::atomic<bool> ponder_stop;
+    SearchResult ponder_result;
+    std::vector<std::pair<Board, int>> ponder_base;
+
+    // The fewest visits a node needs to keep its children for the subtree
+    // under start to fit in target bytes; 0 when it fits whole or there is
+    // no memory limit.
+    int prune_threshold(Node& start, size_t target) {
+        if (memory_limit == 0) {
+            return 0;
+        }
+
+        size_t bytes[33] = {};
+        start.tally(bytes);
+        size_t kept = sizeof(Node);
+        for (int bits = 32; bits > 0; --bits) {
+            if (kept + bytes[bits] > target) {
+                return bits >= 31 ? INT_MAX : 1 << bits;
+            }
+
+            kept += bytes[bits];
+        }
+
+        return kept + bytes[0] > target ? 1 : 0;
+    }
+
+    // Copies source, pruned at min_visits, into the spare arenas and makes
+    // the copy the root. Not safe while a search is running.
+    void relocate(Node& source, int min_visits) {
+        Arena<Node>& spare = arenas[1 - current];
+        Arena<SlotGroup>& spare_slots = slot_arenas[1 - current];
+        spare.reset();
+        spare_slots.reset();
+
+        Node* next = new (spare.allocate(1)) Node(source);
+        next->reopen();
+        next->adopt_subtree(spare, spare_slots, min_visits);
+
+        if (memory_limit > 0) {
+            arenas[current].release();
+            slot_arenas[current].release();
+        } else {
+            arenas[current].reset();
+            slot_arenas[current].reset();
+        }
+
+        current = 1 - current;
+        root = next;
+    }
+
+    // Searches in rounds, pruning the tree between them whenever a round
+    // ends because the tree is full.
+    SearchResult run(long iterations, int threads, Deadline deadline, int batch, int solve_empties,
+                     double exploration, const std::atomic<bool>* stop) {
+        SearchResult total = {};
+        for (;;) {
+            // Each round gets its own seed, so a game replays from master_seed.
+            uint64_t state = seed + searches++;
+            long left = iterations > 0 ? iterations - total.iterations : 0;
+            SearchContext context{&arenas[current], &slot_arenas[current], table.get(), batch, solve_empties,
+                                  splitmix64(state), stop, exploration, evaluator, eval_plies,
+                                  memory_limit / 3 * 2};
+            SearchResult result = root->search(context, left, threads, deadline);
+            total.iterations += result.iterations;
+            total.seconds += result.seconds;
+            total.max_depth = std::max(total.max_depth, result.max_depth);
+            total.stats.merge(result.stats);
+
+            bool full = memory_limit > 0 && node_bytes() >= context.memory_limit;
+            bool finished = result.iterations == 0 || (iterations > 0 && total.iterations >= iterations)
+                            || (stop != nullptr && stop->load()) || std::chrono::steady_clock::now() >= deadline;
+            if (!full || finished) {
+                return total;
+            }
+
+            std::lock_guard<std::mutex> lock(layout);
+            relocate(*root, prune_threshold(*root, memory_limit / 3));
+            ++compactions;
+        }
+    }
+
+public:
+    // A non-zero table_mb shares statistics between transpositions through a
+    // table of that size, kept for the life of the tree.
+    Tree(Board board, Player turn, size_t table_mb)
+        : current(0), seed(master_seed), searches(0), evaluator(nullptr), eval_plies(0), memory_limit(0),
+          compactions(0), ponder_stop(false), ponder_result{} {
+        root = new (arenas[current].allocate(1)) Node(board, turn);
+        if (table_mb > 0) {
+            table.reset(new TranspositionTable(table_mb));
+        }
+    }
+
+    ~Tree() {
+        stop_pondering();
+    }
+
+    Node& get_root() {
+        return *root;
+    }
+
+    // Searches derive their seeds from master_seed unless this says otherwise.
+    // The searches after this one replay the same sequence of seeds.
+    void set_seed(uint64_t value) {
+        seed = value;
+        searches = 0;
+    }
+
+    // Leaves are scored by value after plies random moves instead of being
+    // played out, unless value is null.
+    void set_evaluator(const PatternEvaluator* value, int plies) {
+        evaluator = value;
+        eval_plies = plies;
+    }
+
+    // Caps the memory of the tree at bytes, 0 for no cap. Takes effect from
+    // the next search or advance().
+    void set_memory_limit(size_t bytes) {
+        memory_limit = bytes;
+    }
+
+    // Another thread may read the tree during a search while it holds this;
+    // the tree then stays where it is.
+    std::unique_lock<std::mutex> lock_layout() {
+        return std::unique_lock<std::mutex>(layout);
+    }
+
+    // time_ms <= 0 searches without a deadline; a non-zero batch switches to
+    // leaf-parallel iterations of that many lanes; positions with at most
+    // solve_empties empty squares are solved exactly; exploration is the UCT
+    // constant, normally EXPLORATION. Setting a non-null stop from another
+    // thread ends the search early.
+    SearchResult search(long iterations, int threads, long time_ms, int batch, int solve_empties,
+                        double exploration, const std::atomic<bool>* stop) {
+        Deadline deadline = Deadline::max();
+        if (time_ms > 0) {
+            deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(time_ms);
+        }
+
+        stop_pondering();
+        return run(iterations, threads, deadline, batch, solve_empties, exploration, stop);
+    }
+
+    // Keeps searching the root on a background thread until stop_pondering(),
+    // the next search() or advance(). Stops by itself after iterations if
+    // that is positive. Does nothing at the end of the game.
+    void ponder(long iterations, int threads, int batch, int solve_empties, double exploration) {
+        stop_pondering();
+        if (root->is_terminal()) {
+            return;
+        }
+
+        ponder_base.clear();
+        for (int slot = 0; slot < root->child_count(); ++slot) {
+            Node* child = root->child(slot);
+            if (child != nullptr) {
+                ponder_base.emplace_back(child->get_board(), child->get_simulations());
+            }
+        }
+
+        ponder_stop.store(false);
+        ponder_result = SearchResult{};
+        ponderer = std::thread([this, iterations, threads, batch, solve_empties, exploration]() {
+            ponder_result = run(iterations, threads, Deadline::max(), batch, solve_empties, exploration,
+                                &ponder_stop);
+        });
+    }
+
+    // Waits for a running ponder to wind down; the tree is quiet afterwards.
+    void stop_pondering() {
+        if (ponderer.joinable()) {
+            ponder_stop.store(true);
+            ponderer.join();
+        }
+    }
+
+    // What the last ponder did, once it has stopped.
+    SearchResult get_ponder_result() {
+        return ponder_result;
+    }
+
+    // Simulations the last ponder added below move, the move that was
+    // actually played. Only meaningful before advance().
+    int pondered_simulations(Board move) {
+        Node* child = root->choose_move(move);
+        if (child == nullptr) {
+            return 0;
+        }
+
+        int base = 0;
+        for (std::pair<Board, int>& entry : ponder_base) {
+            if (entry.first == move) {
+                base = entry.second;
+            }
+        }
+
+        return child->get_simulations() - base;
+    }
+
+    // Starts over from an unrelated position. The transposition table is
+    // kept, its entries are still valid.
+    void reset(Board board, Player turn) {
+        stop_pondering();
+        arenas[0].reset();
+        arenas[1].reset();
+        slot_arenas[0].reset();
+        slot_arenas[1].reset();
+        current = 0;
+        root = new (arenas[current].allocate(1)) Node(board, turn);
+        ponder_base.clear();
+    }
+
+    // Makes the position after move the new root and returns how many
+    // simulations it inherited from the previous search.
+    int advance(Board move) {
+        stop_pondering();
+        Node* child = root->choose_move(move);
+        int inherited = 0;
+        if (child != nullptr) {
+            inherited = child->get_simulations();
+            relocate(*child, prune_threshold(*child, memory_limit / 3));
+        } else {
+            Node fresh(move, opponent(root->get_turn()));
+            relocate(fresh, 0);
+        }
+
+        ponder_base.clear();
+        return inherited;
+    }
+
+    size_t node_count() {
+        return arenas[current].size();
+    }
+
+    // Nodes and the child statistics beside them.
+    size_t node_bytes() {
+        return arenas[current].bytes() + slot_arenas[current].bytes();
+    }
+
+    size_t reserved_bytes() {
+        return arenas[0].reserved_bytes() + arenas[1].reserved_bytes()
+               + slot_arenas[0].reserved_bytes() + slot_arenas[1].reserved_bytes();
+    }
+
+    // Times a full tree has been pruned during a search.
+    long get_compactions() {
+        return compactions;
+    }
+
+    // Null when the tree was built without a transposition table.
+    TranspositionTable* get_table() {
+        return table.get();
+    }
+};
+
+// Iterations per second from the opening position at 1, 2, 4, ... threads,
+// always finishing with max_threads itself.
+void scaling_report(int max_threads, long iterations) {
+    std::cout << "Move kernel: " << move_kernel.name << std::endl;
+    double base_rate = 0;
+    for (int threads = 1; ; threads *= 2) {
+        if (threads > max_threads) {
+            threads = max_threads;
+        }
+
+        Tree tree(Board::opening_position(), Player::dark, 0);
+        SearchResult result = tree.search(iterations, threads, 0, 0, SOLVE_EMPTIES, EXPLORATION, nullptr);
+
+        double rate = result.iterations / result.seconds;
+        if (threads == 1) {
+            base_rate = rate;
+        }
+
+        std::cout << "Threads: " << threads
+                  << "  Iterations/sec: " << (long) rate
+                  << "  Speedup: " << rate / base_rate << std::endl;
+
+        if (threads == max_threads) {
+            break;
+        }
+    }
+}
+
+// Random games per second from the opening, one at a time with playout()
+// and then batched at 4, 8 and 16 lanes, all for the same number of games.
+void batch_report(int games) {
+    std::cout << "Move kernel: " << move_kernel.name << std::endl;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < games; ++i) {
+        playout(Board::opening_position(), Player::dark);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double base_rate = games / elapsed.count();
+    std::cout << "Lanes: 1  Playouts/sec: " << (long) base_rate << "  Speedup: 1" << std::endl;
+
+    std::vector<PlayoutJob> jobs(games, PlayoutJob{Board::opening_position(), Player::dark, Player::dark});
+    for (int lanes = 4; lanes <= MAX_BATCH; lanes *= 2) {
+        start = std::chrono::steady_clock::now();
+        batch_kernel()(jobs.data(), games, lanes);
+        elapsed = std::chrono::steady_clock::now() - start;
+
+        double rate = games / elapsed.count();
+        std::cout << "Lanes: " << lanes
+                  << "  Playouts/sec: " << (long) rate
+                  << "  Speedup: " << rate / base_rate << std::endl;
+    }
+}
+
+// Solves a fixed set of positions with the given number of empties, reached
+// by random play from the opening with a fixed seed, first for win/loss/draw
+// and then for the exact disk difference.
+void endgame_report(int empties, int positions) {
+    Rng generator(1);
+    std::vector<std::pair<Board, Player>> set;
+    while ((int) set.size() < positions) {
+        Board board = Board::opening_position();
+        Player turn = Player::dark;
+        while (64 - board.occupied().bits_set() > empties) {
+            BitBoard moves = board.move_bits(turn);
+            if (moves.is_empty()) {
+                break;
+            }
+
+            board = board.place_disk(turn, moves.select_bit(generator.below(moves.bits_set())));
+            turn = opponent(turn);
+        }
+
+        if (64 - board.occupied().bits_set() == empties && !board.move_bits(turn).is_empty()) {
+            set.emplace_back(board, turn);
+        }
+    }
+
+    std::cout << "Move kernel: " << move_kernel.name << std::endl;
+    for (int exact = 0; exact < 2; ++exact) {
+        EndgameSolver solver;
+        auto start = std::chrono::steady_clock::now();
+        for (auto& position : set) {
+            if (exact) {
+                solver.solve(position.first, position.second, -64, 64);
+            } else {
+                solver.solve_outcome(position.first, position.second);
+            }
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        std::cout << (exact ? "Exact" : "Win/loss/draw")
+                  << "  Empties: " << empties
+                  << "  Positions: " << positions
+                  << "  Nodes: " << solver.get_nodes()
+                  << "  Seconds: " << elapsed.count()
+                  << "  Nodes/sec: " << (long) (solver.get_nodes() / elapsed.count()) << std::endl;
+    }
+}
+
+// Plays the given number of random games and, in every position reached,
+// checks the table-driven place_disk() against place_disk_reference() for
+// every legal move.
+bool validate_flips(int games) {
+    Rng generator(1);
+    long checked = 0;
+    long mismatches = 0;
+    for (int game = 0; game < games; ++game) {
+        Board board = Board::opening_position();
+        Player turn = Player::dark;
+        for (;;) {
+            BitBoard moves = board.move_bits(turn);
+            if (moves.is_empty()) {
+                break;
+            }
+
+            for (BitBoard remaining = moves; !remaining.is_empty(); ) {
+                int index = remaining.peel_bit();
+                if (!(board.place_disk(turn, index) == board.place_disk_reference(turn, index))) {
+                    ++mismatches;
+                }
+                ++checked;
+            }
+
+            board = board.place_disk(turn, moves.select_bit(generator.below(moves.bits_set())));
+            turn = opponent(turn);
+        }
+    }
+
+    std::cout << "Moves checked: " << checked << "  Mismatches: " << mismatches << std::endl;
+    return mismatches == 0;
+}
+
+// Leaf count of the full game tree to depth from (own, opp), own to move.
+// Follows the usual Othello perft convention so results can be checked
+// against published values: a forced pass counts as a ply, and a finished
+// game counts as one leaf wherever it ends.
+long perft(uint64_t own, uint64_t opp, int depth) {
+    if (depth == 0) {
+        return 1;
+    }
+
+    uint64_t moves = move_kernel.kernel(own, opp) & ~(own | opp);
+    if (moves == 0) {
+        if ((move_kernel.kernel(opp, own) & ~(own | opp)) == 0) {
+            return 1;
+        }
+
+        return perft(opp, own, depth - 1);
+    }
+
+    if (depth == 1) {
+        return __builtin_popcountll(moves);
+    }
+
+    long leaves = 0;
+    Board board(own, opp);
+    while (moves != 0) {
+        Board after = board.place_disk(Player::dark, __builtin_ctzll(moves));
+        leaves += perft(after.disks(Player::light).get_bits(), after.disks(Player::dark).get_bits(), depth - 1);
+        moves &= moves - 1;
+    }
+
+    return leaves;
+}
+
+// Positions from seeded random games, used as a fixed workload.
+std::vector<std::pair<Board, Player>> bench_positions(int games) {
+    Rng generator(1);
+    std::vector<std::pair<Board, Player>> positions;
+    for (int game = 0; game < games; ++game) {
+        Board board = Board::opening_position();
+        Player turn = Player::dark;
+        for (;;) {
+            BitBoard moves = board.move_bits(turn);
+            if (moves.is_empty()) {
+                break;
+            }
+
+            positions.emplace_back(board, turn);
+            board = board.place_disk(turn, moves.select_bit(generator.below(moves.bits_set())));
+            turn = opponent(turn);
+        }
+    }
+
+    return positions;
+}
+
+// Best of several timed runs of body, in seconds. The best run is the one
+// least disturbed by the rest of the machine, which keeps results stable.
+template <typename Body>
+double best_time(int runs, Body body) {
+    double best = 1e300;
+    for (int run = 0; run < runs; ++run) {
+        auto start = std::chrono::steady_clock::now();
+        body();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+
+    return best;
+}
+
+void bench_line(const char* name, const char* unit, double rate) {
+    std::cout << "{\"bench\":\"" << name << "\",\"kernel\":\"" << move_kernel.name
+              << "\",\"" << unit << "\":" << (long) rate << "}" << std::endl;
+}
+
+// Benchmark suite for the hot paths, one JSON object per line: perft from
+// the opening checked against reference leaf counts, then move generation,
+// flipping, playouts, endgame solving and MCTS throughput. Workloads are
+// fixed by seed and each figure is the best of five runs. Returns false if
+// any perft count is wrong.
+bool bench(int perft_depth) {
+    static const long perft_reference[] = {
+        1, 4, 12, 56, 244, 1396, 8200, 55092, 390216, 3005288, 24571284, 212258800,
+    };
+
+    bool correct = true;
+    Board opening = Board::opening_position();
+    for (int depth = 1; depth <= perft_depth; ++depth) {
+        long leaves = 0;
+        double seconds = best_time(depth < perft_depth ? 1 : 5, [&]() {
+            leaves = perft(opening.disks(Player::dark).get_bits(), opening.disks(Player::light).get_bits(), depth);
+        });
+
+        bool ok = depth > 11 || leaves == perft_reference[depth];
+        correct = correct && ok;
+        std::cout << "{\"bench\":\"perft\",\"kernel\":\"" << move_kernel.name
+                  << "\",\"depth\":" << depth << ",\"leaves\":" << leaves
+                  << ",\"ok\":" << (ok ? "true" : "false")
+                  << ",\"leaves_per_sec\":" << (long) (leaves / seconds) << "}" << std::endl;
+    }
+
+    std::vector<std::pair<Board, Player>> positions = bench_positions(2000);
+    uint64_t sink = 0;
+
+    double seconds = best_time(5, [&]() {
+        for (int repeat = 0; repeat < 10; ++repeat) {
+            for (auto& position : positions) {
+                sink ^= position.first.move_bits(position.second).get_bits();
+            }
+        }
+    });
+    bench_line("move_bits", "calls_per_sec", positions.size() * 10 / seconds);
+
+    long placements = 0;
+    for (auto& position : positions) {
+        placements += position.first.move_bits(position.second).bits_set();
+    }
+
+    seconds = best_time(5, [&]() {
+        for (auto& position : positions) {
+            BitBoard moves = position.first.move_bits(position.second);
+            while (!moves.is_empty()) {
+                sink ^= position.first.place_disk(position.second, moves.peel_bit()).bits[0].get_bits();
+            }
+        }
+    });
+    bench_line("place_disk", "calls_per_sec", placements / seconds);
+
+    const int games = 20000;
+    seconds = best_time(5, [&]() {
+        for (int game = 0; game < games; ++game) {
+            sink ^= static_cast<int>(playout(opening, Player::dark));
+        }
+    });
+    bench_line("playout", "games_per_sec", games / seconds);
+
+    std::vector<PlayoutJob> jobs(games, PlayoutJob{opening, Player::dark, Player::dark});
+    seconds = best_time(5, [&]() {
+        batch_kernel()(jobs.data(), games, 8);
+    });
+    bench_line("batch_playout_8", "games_per_sec", games / seconds);
+
+    std::vector<std::pair<Board, Player>> endgames;
+    for (auto& position : positions) {
+        if (64 - position.first.occupied().bits_set() == 12 && endgames.size() < 50) {
+            endgames.push_back(position);
+        }
+    }
+
+    long nodes = 0;
+    seconds = best_time(5, [&]() {
+        EndgameSolver solver;
+        for (auto& position : endgames) {
+            solver.solve(position.first, position.second, -64, 64);
+        }
+        nodes = solver.get_nodes();
+    });
+    bench_line("endgame_12", "nodes_per_sec", nodes / seconds);
+
+    const long iterations = 100000;
+    size_t tree_bytes = 0;
+    seconds = best_time(5, [&]() {
+        Tree tree(opening, Player::dark, 0);
+        tree.search(iterations, 1, 0, 0, SOLVE_EMPTIES, EXPLORATION, nullptr);
+        tree_bytes = tree.node_bytes();
+    });
+    bench_line("mcts", "iterations_per_sec", iterations / seconds);
+    bench_line("mcts_tree", "bytes_per_iteration", (double) tree_bytes / iterations);
+
+    // Keeps the compiler from discarding the benchmarked work.
+    volatile uint64_t keep = sink;
+    (void) keep;
+    return correct;
+}
+
+// Square names run a1 (bit 0) to h8 (bit 63): the letter is the column
+// and the digit the row, matching place_disk(player, x, y).
+std::string square_name(int square) {
+    std::string name;
+    name += (char) ('a' + square % 8);
+    name += (char) ('1' + square / 8);
+    return name;
+}
+
+// -1 unless name is a square name.
+int parse_square(const std::string& name) {
+    if (name.size() != 2 || name[0] < 'a' || name[0] > 'h' || name[1] < '1' || name[1] > '8') {
+        return -1;
+    }
+
+    return (name[1] - '1') * 8 + (name[0] - 'a');
+}
+
+// One book position in canonical form, the smallest (dark, light) pair over
+// the eight symmetries, with the move found for it in the same frame.
+struct BookEntry {
+    uint64_t dark;
+    uint64_t light;
+    uint32_t visits;
+    uint8_t turn;
+    uint8_t move;
+    uint16_t reserved;
+
+    bool operator<(const BookEntry& other) const {
+        if (dark != other.dark) {
+            return dark < other.dark;
+        }
+
+        if (light != other.light) {
+            return light < other.light;
+        }
+
+        return turn < other.turn;
+    }
+};
+
+// Book files are this header followed by count BookEntry records sorted by
+// key, in host byte order.
+struct BookHeader {
+    char magic[8];
+    uint64_t count;
+};
+
+const char book_magic[8] = {'O', 'T', 'H', 'B', 'O', 'O', 'K', '1'};
+
+// Canonical key for board with turn to move; sym receives the symmetry that
+// maps board onto it.
+BookEntry book_key(Board board, Player turn, int& sym) {
+    BookEntry key = {};
+    key.turn = static_cast<uint8_t>(turn);
+    for (int s = 0; s < 8; ++s) {
+        BookEntry candidate = key;
+        candidate.dark = transform(board.disks(Player::dark).get_bits(), s);
+        candidate.light = transform(board.disks(Player::light).get_bits(), s);
+        if (s == 0 || candidate < key) {
+            key = candidate;
+            sym = s;
+        }
+    }
+
+    return key;
+}
+
+// Read-only view of a book file. The file is mapped rather than read, so
+// opening costs nothing up front and probes binary search the mapping.
+class OpeningBook {
+private:
+    void* mapping;
+    size_t length;
+    const BookEntry* entries;
+    size_t count;
+
+public:
+    OpeningBook() : mapping(nullptr), length(0), entries(nullptr), count(0) {}
+
+    OpeningBook(const OpeningBook&) = delete;
+    OpeningBook& operator=(const OpeningBook&) = delete;
+
+    ~OpeningBook() {
+        if (mapping != nullptr) {
+            munmap(mapping, length);
+        }
+    }
+
+    // False if path is missing or not a well formed book.
+    bool open(const char* path) {
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(BookHeader)) {
+            close(fd);
+            return false;
+        }
+
+        void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED) {
+            return false;
+        }
+
+        // count is checked against the room for entries before multiplying,
+        // so a crafted count can't wrap around to the file size.
+        const BookHeader* header = (const BookHeader*) data;
+        size_t room = (size_t) info.st_size - sizeof(BookHeader);
+        if (memcmp(header->magic, book_magic, sizeof(book_magic)) != 0
+                || header->count > room / sizeof(BookEntry) || header->count * sizeof(BookEntry) != room) {
+            munmap(data, info.st_size);
+            return false;
+        }
+
+        mapping = data;
+        length = info.st_size;
+        entries = (const BookEntry*) (header + 1);
+        count = header->count;
+        return true;
+    }
+
+    // The book move for board as a square, or -1 when it is not in the book.
+    int probe(Board board, Player turn) const {
+        int sym = 0;
+        BookEntry key = book_key(board, turn, sym);
+        const BookEntry* found = std::lower_bound(entries, entries + count, key);
+        if (found == entries + count || key < *found) {
+            return -1;
+        }
+
+        uint64_t target = (uint64_t) 1 << found->move;
+        BitBoard moves = board.move_bits(turn);
+        while (!moves.is_empty()) {
+            int square = __builtin_ctzll(moves.get_bits());
+            if (transform((uint64_t) 1 << square, sym) == target) {
+                return square;
+            }
+
+            moves = BitBoard(moves.get_bits() & (moves.get_bits() - 1));
+        }
+
+        return -1;
+    }
+
+    size_t size() const {
+        return count;
+    }
+};
+
+// Game record files: the magic, then one record per game. A record is a
+// RecordHeader with the start position and final disk margin followed by
+// its moves, all 8-byte aligned so that a mapped file can be read in place.
+const char record_magic[8] = {'O', 'T', 'H', 'G', 'A', 'M', 'E', '1'};
+
+struct RecordHeader {
+    uint64_t dark;
+    uint64_t light;
+    uint16_t move_count;
+    uint8_t turn;
+    int8_t margin;     // dark disks minus light disks at the end
+    uint32_t reserved;
+};
+
+// One move with the search behind it; a book move has no visits.
+struct RecordMove {
+    uint8_t square;
+    uint8_t flags;
+    uint16_t confidence; // root confidence() scaled to 0..65535
+    uint32_t visits;     // simulations of the chosen child
+};
+
+#define RECORD_BOOK 1
+
+// A game being played, built up by one thread and handed to a GameWriter.
+struct GameRecord {
+    RecordHeader header;
+    std::vector<RecordMove> moves;
+
+    GameRecord(Board start, Player turn) : header{} {
+        header.dark = start.disks(Player::dark).get_bits();
+        header.light = start.disks(Player::light).get_bits();
+        header.turn = static_cast<uint8_t>(turn);
+    }
+
+    // Records move, a child position of root, before the tree advances.
+    void add(Node& root, Board move, uint8_t flags) {
+        RecordMove entry = {};
+        entry.square = __builtin_ctzll((move.occupied() & ~root.get_board().occupied()).get_bits());
+        entry.flags = flags;
+        Node* child = root.choose_move(move);
+        if (child != nullptr && root.get_simulations() > 0) {
+            entry.visits = child->get_simulations();
+            entry.confidence = (uint16_t) (std::min(std::max(root.confidence(), 0.0), 1.0) * 65535);
+        }
+
+        moves.push_back(entry);
+    }
+
+    void finish(Board board) {
+        header.move_count = moves.size();
+        header.margin = board.disks(Player::dark).bits_set() - board.disks(Player::light).bits_set();
+    }
+};
+
+// Appends finished games to a record file from any number of threads.
+// Records are copied into a buffer under a lock and written out in large
+// chunks, so games never wait on the disk individually.
+class GameWriter {
+private:
+    std::ofstream out;
+    std::vector<char> buffer;
+    std::mutex lock;
+    long games;
+
+    void flush_buffer() {
+        out.write(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+
+public:
+    GameWriter() : games(0) {}
+
+    ~GameWriter() {
+        close();
+    }
+
+    bool open(const char* path) {
+        out.open(path, std::ios::binary | std::ios::trunc);
+        out.write(record_magic, sizeof(record_magic));
+        buffer.reserve(1 << 20);
+        return (bool) out;
+    }
+
+    void append(const GameRecord& record) {
+        std::lock_guard<std::mutex> guard(lock);
+        const char* header = (const char*) &record.header;
+        const char* moves = (const char*) record.moves.data();
+        buffer.insert(buffer.end(), header, header + sizeof(RecordHeader));
+        buffer.insert(buffer.end(), moves, moves + record.moves.size() * sizeof(RecordMove));
+        ++games;
+        if (buffer.size() >= (1 << 20)) {
+            flush_buffer();
+        }
+    }
+
+    // Writes out what is buffered; true if every write so far succeeded.
+    bool close() {
+        std::lock_guard<std::mutex> guard(lock);
+        if (out.is_open()) {
+            flush_buffer();
+            out.close();
+        }
+
+        return !out.fail();
+    }
+
+    long get_games() {
+        return games;
+    }
+};
+
+// Iterates over a mapped record file without copying: next() hands out
+// pointers into the mapping.
+class GameReader {
+private:
+    void* mapping;
+    size_t length;
+    size_t offset;
+
+public:
+    GameReader() : mapping(nullptr), length(0), offset(0) {}
+
+    GameReader(const GameReader&) = delete;
+    GameReader& operator=(const GameReader&) = delete;
+
+    ~GameReader() {
+        if (mapping != nullptr) {
+            munmap(mapping, length);
+        }
+    }
+
+    bool open(const char* path) {
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(record_magic)) {
+            close(fd);
+            return false;
+        }
+
+        void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED) {
+            return false;
+        }
+
+        if (memcmp(data, record_magic, sizeof(record_magic)) != 0) {
+            munmap(data, info.st_size);
+            return false;
+        }
+
+        madvise(data, info.st_size, MADV_SEQUENTIAL);
+        mapping = data;
+        length = info.st_size;
+        offset = sizeof(record_magic);
+        return true;
+    }
+
+    // The next game, or false at the end of the file or at a truncated
+    // record.
+    bool next(const RecordHeader*& header, const RecordMove*& moves) {
+        const char* base = (const char*) mapping;
+        if (offset + sizeof(RecordHeader) > length) {
+            return false;
+        }
+
+        header = (const RecordHeader*) (base + offset);
+        size_t size = sizeof(RecordHeader) + header->move_count * sizeof(RecordMove);
+        if (offset + size > length) {
+            return false;
+        }
+
+        moves = (const RecordMove*) (base + offset + sizeof(RecordHeader));
+        offset += size;
+        return true;
+    }
+};
+
+// Text form of a record file, one game per line: the start position as in
+// the protocol's position command, the final margin, then square:visits:
+// confidence for searched moves and square:book for book moves.
+bool dump_games(const char* path) {
+    GameReader reader;
+    if (!reader.open(path)) {
+        return false;
+    }
+
+    const RecordHeader* header;
+    const RecordMove* moves;
+    while (reader.next(header, moves)) {
+        std::string line;
+        for (int square = 0; square < 64; ++square) {
+            line += ((header->dark >> square) & 1) ? 'x' : ((header->light >> square) & 1) ? 'o' : '-';
+        }
+
+        line += header->turn == static_cast<uint8_t>(Player::dark) ? " x " : " o ";
+        line += std::to_string(header->margin);
+        for (int i = 0; i < header->move_count; ++i) {
+            line += " " + square_name(moves[i].square);
+            if (moves[i].flags & RECORD_BOOK) {
+                line += ":book";
+            } else {
+                line += ":" + std::to_string(moves[i].visits) + ":" + std::to_string(moves[i].confidence / 65535.0);
+            }
+        }
+
+        std::cout << line << '\n';
+    }
+
+    std::cout << std::flush;
+    return true;
+}
+
+// Splits one side's total game time over the moves it still has to play,
+// estimated from the number of empty squares.
+class Clock {
+private:
+    long remaining_ms;
+
+public:
+    Clock(long total_ms) : remaining_ms(total_ms) {}
+
+    long budget(Board board) {
+        int empties = 64 - board.occupied().bits_set();
+        int moves_left = std::max(1, (empties + 1) / 2);
+        return std::max(1L, remaining_ms / moves_left);
+    }
+
+    void consume(double seconds) {
+        remaining_ms -= (long) (seconds * 1000);
+    }
+
+    long get_remaining() {
+        return remaining_ms;
+    }
+};
+
+class RootParallel;
+
+struct SearchConfig {
+    int threads;
+    long iterations;   // <= 0 for no limit
+    long move_time_ms; // <= 0 for no per-move cap
+    long game_time_ms; // <= 0 for no game clock
+    int batch;         // lanes per leaf-parallel iteration, 0 to disable
+    long table_mb;     // transposition table size, 0 to disable
+    int solve_empties; // exact solving threshold, 0 to disable
+    bool ponder;       // keep searching while the opponent is to move
+    double exploration; // UCT exploration constant
+    const OpeningBook* book; // probed before searching, may be null
+    const PatternEvaluator* evaluator; // loaded pattern weights, may be null
+    int eval_plies;    // evaluate leaves after this many plies, -1 to play out
+    long memory_mb;    // cap on each tree's memory, 0 for none
+    RootParallel* root_parallel; // searches in worker processes instead, may be null
+};
+
+// Hands the settings of config that live in the tree to tree: leaf
+// evaluation and the memory cap.
+void apply_config(Tree& tree, const SearchConfig& config) {
+    tree.set_evaluator(config.eval_plies >= 0 ? config.evaluator : nullptr, config.eval_plies);
+    tree.set_memory_limit((size_t) config.memory_mb << 20);
+}
+
+// One JSON object per move for dashboards: search totals, tree size and
+// memory, and the SearchStats counters with times in milliseconds.
+void print_stats(Tree& tree, SearchResult& result) {
+    SearchStats& stats = result.stats;
+    TranspositionTable* table = tree.get_table();
+    std::cout << "{\"move\":" << tree.get_root().get_board().occupied().bits_set() - 3
+              << ",\"iterations\":" << result.iterations
+              << ",\"seconds\":" << result.seconds
+              << ",\"iterations_per_sec\":" << (long) (result.iterations / result.seconds)
+              << ",\"max_depth\":" << result.max_depth
+              << ",\"avg_depth\":" << (double) stats.depth_total / std::max(1L, result.iterations)
+              << ",\"expansions\":" << stats.expansions
+              << ",\"solves\":" << stats.solves
+              << ",\"playouts\":" << stats.playouts
+              << ",\"terminal_hits\":" << stats.terminal_hits
+              << ",\"tree_nodes\":" << tree.node_count()
+              << ",\"tree_bytes\":" << tree.node_bytes()
+              << ",\"arena_bytes\":" << tree.reserved_bytes()
+              << ",\"compactions\":" << tree.get_compactions()
+              << ",\"table_bytes\":" << (table != nullptr ? table->bytes() : 0)
+              << ",\"select_ms\":" << stats.select_ns / 1e6
+              << ",\"expand_ms\":" << stats.expand_ns / 1e6
+              << ",\"solve_ms\":" << stats.solve_ns / 1e6
+              << ",\"playout_ms\":" << stats.playout_ns / 1e6
+              << ",\"backprop_ms\":" << stats.backprop_ns / 1e6
+              << "}" << std::endl;
+}
+
+// Root-parallel search: worker processes search the same root, each with a
+// tree and seed of its own, and send their root-child counts back over a
+// Unix stream socket. The coordinator sums the counts per move and picks
+// the most visited. The messages are fixed-size structs and the workers
+// only ever see the socket, so they could as well sit on other hosts.
+struct RootRequest {
+    uint64_t dark;
+    uint64_t light;
+    uint8_t turn;
+    uint8_t quit;     // the worker exits instead of searching
+    uint8_t reserved[6];
+    int64_t iterations;
+    int64_t time_ms;
+};
+
+struct RootReply {
+    int64_t iterations;
+    int32_t visits[64]; // per square, zero for squares that are not moves
+    int64_t wins[64];   // the mover's credit through each move, in WIN_UNIT
+};
+
+// What the coordinator makes of the replies to one request.
+struct RootResult {
+    int square;        // the most visited move, -1 at the end of the game
+    long iterations;   // summed over the workers
+    double seconds;    // wall time of the whole round
+    double confidence; // the mover's merged win rate
+};
+
+// Blocking send and receive of exactly size bytes; false once the peer is gone.
+bool send_all(int fd, const void* data, size_t size) {
+    const char* bytes = (const char*) data;
+    while (size > 0) {
+        ssize_t sent = send(fd, bytes, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        } else if (sent <= 0) {
+            return false;
+        }
+
+        bytes += sent;
+        size -= sent;
+    }
+
+    return true;
+}
+
+bool receive_all(int fd, void* data, size_t size) {
+    char* bytes = (char*) data;
+    while (size > 0) {
+        ssize_t received = recv(fd, bytes, size, 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        } else if (received <= 0) {
+            return false;
+        }
+
+        bytes += received;
+        size -= received;
+    }
+
+    return true;
+}
+
+class RootParallel {
+private:
+    std::string path;
+    std::vector<int> sockets;
+    std::vector<pid_t> children;
+
+    // Moves tree to board when it lies one or two plies below the root, so
+    // the worker keeps what it learnt there; otherwise starts over.
+    static void follow(Tree& tree, Board board, Player turn) {
+        Node& root = tree.get_root();
+        if (root.get_board() == board && root.get_turn() == turn) {
+            return;
+        }
+
+        Node* child = root.choose_move(board);
+        if (child != nullptr && child->get_turn() == turn) {
+            tree.advance(board);
+            return;
+        }
+
+        for (int slot = 0; slot < root.child_count(); ++slot) {
+            Node* reply = root.child(slot);
+            Node* grandchild = reply != nullptr ? reply->choose_move(board) : nullptr;
+            if (grandchild != nullptr && grandchild->get_turn() == turn) {
+                tree.advance(reply->get_board());
+                tree.advance(board);
+                return;
+            }
+        }
+
+        tree.reset(board, turn);
+    }
+
+    // The body of worker process index: answers requests on fd until told
+    // to quit or the coordinator goes away.
+    static void serve(int fd, int index, const SearchConfig& config) {
+        Tree tree(Board::opening_position(), Player::dark, config.table_mb);
+        uint64_t state = master_seed ^ ((index + 1) * 0x9e3779b97f4a7c15);
+        tree.set_seed(splitmix64(state));
+        apply_config(tree, config);
+
+        RootRequest request;
+        while (receive_all(fd, &request, sizeof(request)) && !request.quit) {
+            Board board(BitBoard(request.dark), BitBoard(request.light));
+            follow(tree, board, static_cast<Player>(request.turn));
+            SearchResult result = tree.search(request.iterations, config.threads, request.time_ms, config.batch,
+                                              config.solve_empties, config.exploration, nullptr);
+
+            RootReply reply = {};
+            reply.iterations = result.iterations;
+            Node& root = tree.get_root();
+            for (int slot = 0; slot < root.child_count(); ++slot) {
+                Node* child = root.child(slot);
+                if (child != nullptr) {
+                    int square = __builtin_ctzll((child->get_board().occupied() & ~board.occupied()).get_bits());
+                    reply.visits[square] = child->get_simulations();
+                    reply.wins[square] = (int64_t) child->get_simulations() * WIN_UNIT - child->get_wins();
+                }
+            }
+
+            if (!send_all(fd, &reply, sizeof(reply))) {
+                break;
+            }
+        }
+    }
+
+public:
+    RootParallel() {}
+
+    RootParallel(const RootParallel&) = delete;
+    RootParallel& operator=(const RootParallel&) = delete;
+
+    ~RootParallel() {
+        stop();
+    }
+
+    // Forks that many worker processes searching with config, each on
+    // config.threads threads. Call before any other thread is started.
+    bool start(int workers, const SearchConfig& config) {
+        path = "/tmp/othello-root-" + std::to_string(getpid()) + ".sock";
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+        int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        unlink(path.c_str());
+        if (listener < 0 || bind(listener, (sockaddr*) &address, sizeof(address)) != 0
+                || listen(listener, workers) != 0) {
+            if (listener >= 0) {
+                close(listener);
+            }
+            return false;
+        }
+
+        for (int index = 0; index < workers; ++index) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                close(listener);
+                int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+                if (fd >= 0 && connect(fd, (sockaddr*) &address, sizeof(address)) == 0) {
+                    serve(fd, index, config);
+                }
+                _exit(0);
+            } else if (pid > 0) {
+                children.push_back(pid);
+            }
+        }
+
+        while (sockets.size() < children.size()) {
+            int fd = accept(listener, nullptr, nullptr);
+            if (fd < 0 && errno == EINTR) {
+                continue;
+            } else if (fd < 0) {
+                break;
+            }
+
+            sockets.push_back(fd);
+        }
+
+        close(listener);
+        unlink(path.c_str());
+        return workers > 0 && (int) sockets.size() == workers;
+    }
+
+    int worker_count() {
+        return sockets.size();
+    }
+
+    // Every worker searches board for iterations each, or until time_ms
+    // passes when that is positive; the counts come back merged.
+    RootResult search(Board board, Player turn, long iterations, long time_ms) {
+        auto start = std::chrono::steady_clock::now();
+        RootRequest request = {};
+        request.dark = board.disks(Player::dark).get_bits();
+        request.light = board.disks(Player::light).get_bits();
+        request.turn = static_cast<uint8_t>(turn);
+        request.iterations = iterations;
+        request.time_ms = time_ms;
+        for (int fd : sockets) {
+            send_all(fd, &request, sizeof(request));
+        }
+
+        long visits[64] = {};
+        long wins[64] = {};
+        RootResult result = {-1, 0, 0, 0.5};
+        for (int fd : sockets) {
+            RootReply reply;
+            if (!receive_all(fd, &reply, sizeof(reply))) {
+                continue;
+            }
+
+            result.iterations += reply.iterations;
+            for (int square = 0; square < 64; ++square) {
+                visits[square] += reply.visits[square];
+                wins[square] += reply.wins[square];
+            }
+        }
+
+        long total_visits = 0;
+        long total_wins = 0;
+        long max_visits = -1;
+        uint64_t moves = board.move_bits(turn).get_bits();
+        for (; moves != 0; moves &= moves - 1) {
+            int square = __builtin_ctzll(moves);
+            total_visits += visits[square];
+            total_wins += wins[square];
+            if (visits[square] > max_visits) {
+                max_visits = visits[square];
+                result.square = square;
+            }
+        }
+
+        if (total_visits > 0) {
+            result.confidence = (double) total_wins / ((double) total_visits * WIN_UNIT);
+        }
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        result.seconds = elapsed.count();
+        return result;
+    }
+
+    // Tells the workers to quit and waits for them.
+    void stop() {
+        RootRequest request = {};
+        request.quit = 1;
+        for (int fd : sockets) {
+            send_all(fd, &request, sizeof(request));
+            close(fd);
+        }
+
+        for (pid_t pid : children) {
+            waitpid(pid, nullptr, 0);
+        }
+
+        sockets.clear();
+        children.clear();
+    }
+};
+
+// Searches the root of tree under config, picks the most visited move and
+// reports the search telemetry. clock may be null when there is no game clock.
+// With root-parallel workers configured they search instead, and tree only
+// follows the game.
+Board search_move(Tree& tree, SearchConfig& config, Clock* clock) {
+    long time_ms = config.move_time_ms;
+    if (clock != nullptr) {
+        long budget = clock->budget(tree.get_root().get_board());
+        time_ms = time_ms > 0 ? std::min(time_ms, budget) : budget;
+    }
+
+    if (config.root_parallel != nullptr) {
+        Node& root = tree.get_root();
+        RootResult merged = config.root_parallel->search(root.get_board(), root.get_turn(), config.iterations,
+                                                         time_ms);
+        if (clock != nullptr) {
+            clock->consume(merged.seconds);
+        }
+
+        std::cout << "Confidence: " << merged.confidence << std::endl;
+        std::cout << "Iterations: " << merged.iterations
+                  << "  Iterations/sec: " << (long) (merged.iterations / merged.seconds)
+                  << "  Workers: " << config.root_parallel->worker_count() << std::endl;
+        return root.get_board().place_disk(root.get_turn(), merged.square);
+    }
+
+    apply_config(tree, config);
+    SearchResult result = tree.search(config.iterations, config.threads, time_ms, config.batch,
+                                      config.solve_empties, config.exploration, nullptr);
+    if (clock != nullptr) {
+        clock->consume(result.seconds);
+    }
+
+    std::cout << "Confidence: " << tree.get_root().confidence() << std::endl;
+    std::cout << "Iterations: " << result.iterations
+              << "  Iterations/sec: " << (long) (result.iterations / result.seconds)
+              << "  Depth: " << result.max_depth << std::endl;
+
+    std::cout << "Tree nodes: " << tree.node_count()
+              << "  Tree MB: " << (tree.node_bytes() >> 20)
+              << "  Compactions: " << tree.get_compactions() << std::endl;
+
+    TranspositionTable* table = tree.get_table();
+    if (table != nullptr) {
+        std::cout << "Transposition hit rate: " << table->hit_rate()
+                  << "  Table MB: " << (table->bytes() >> 20) << std::endl;
+    }
+
+#ifdef SEARCH_STATS
+    print_stats(tree, result);
+#endif
+
+    return tree.get_root().best_move().get_board();
+}
+
+// Plays the book move if there is one and searches otherwise. The move is
+// added to record unless it is null.
+Board engine_move(Tree& tree, SearchConfig& config, Clock* clock, GameRecord* record) {
+    Board start = tree.get_root().get_board();
+    Player turn = tree.get_root().get_turn();
+    int square = config.book != nullptr ? config.book->probe(start, turn) : -1;
+    Board board;
+    if (square >= 0) {
+        std::cout << "Book move: " << square_name(square) << std::endl;
+        board = start.place_disk(turn, square);
+    } else {
+        board = search_move(tree, config, clock);
+    }
+
+    // Under a memory cap the search may have moved the root.
+    if (record != nullptr) {
+        record->add(tree.get_root(), board, square >= 0 ? RECORD_BOOK : 0);
+    }
+
+    std::cout << "Inherited simulations: " << tree.advance(board) << std::endl;
+    if (config.ponder) {
+        tree.ponder(config.iterations, config.threads, config.batch, config.solve_empties, config.exploration);
+    }
+
+    return board;
+}
+
+// Hands the opponent's move to a tree that may be pondering: stops the
+// ponder and reports how much of its work survives into the new root.
+void opponent_move(Tree& tree, Board board) {
+    tree.stop_pondering();
+    SearchResult pondered = tree.get_ponder_result();
+    int kept = tree.pondered_simulations(board);
+    int inherited = tree.advance(board);
+    std::cout << "Ponder iterations: " << pondered.iterations
+              << "  Pondered simulations kept: " << kept
+              << "  Inherited simulations: " << inherited << std::endl;
+}
+
+// Searches every position up to plies moves from the opening with config
+// and writes the best moves to path as a book. Positions equal under a
+// symmetry are searched once. Returns false if the file can't be written.
+bool build_book(const char* path, int plies, SearchConfig& config) {
+    std::set<BookEntry> seen;
+    std::vector<std::pair<Board, Player>> positions;
+    std::vector<std::pair<Board, Player>> frontier(1, std::make_pair(Board::opening_position(), Player::dark));
+    for (int ply = 0; ply <= plies; ++ply) {
+        std::vector<std::pair<Board, Player>> next;
+        for (std::pair<Board, Player>& position : frontier) {
+            int sym = 0;
+            if (!seen.insert(book_key(position.first, position.second, sym)).second) {
+                continue;
+            }
+
+            positions.push_back(position);
+            BitBoard moves = position.first.move_bits(position.second);
+            for (int i = 0; i < moves.bits_set(); ++i) {
+                Board child = position.first.place_disk(position.second, moves.select_bit(i));
+                next.push_back(std::make_pair(child, opponent(position.second)));
+            }
+        }
+
+        frontier.swap(next);
+    }
+
+    std::vector<BookEntry> entries;
+    for (std::pair<Board, Player>& position : positions) {
+        Board board = position.first;
+        Player turn = position.second;
+        if (board.move_bits(turn).is_empty()) {
+            continue;
+        }
+
+        Tree tree(board, turn, config.table_mb);
+        apply_config(tree, config);
+        tree.search(config.iterations, config.threads, config.move_time_ms, config.batch,
+                    config.solve_empties, config.exploration, nullptr);
+        Node& best = tree.get_root().best_move();
+        int square = __builtin_ctzll((best.get_board().occupied() & ~board.occupied()).get_bits());
+
+        int sym = 0;
+        BookEntry entry = book_key(board, turn, sym);
+        entry.move = __builtin_ctzll(transform((uint64_t) 1 << square, sym));
+        entry.visits = best.get_simulations();
+        entries.push_back(entry);
+        std::cout << "Book position " << entries.size() << "/" << positions.size()
+                  << "  Empties: " << 64 - board.occupied().bits_set()
+                  << "  Move: " << square_name(square) << "  Visits: " << entry.visits << std::endl;
+    }
+
+    std::sort(entries.begin(), entries.end());
+    BookHeader header = {};
+    memcpy(header.magic, book_magic, sizeof(book_magic));
+    header.count = entries.size();
+
+    std::ofstream out(path, std::ios::binary);
+    out.write((const char*) &header, sizeof(header));
+    out.write((const char*) entries.data(), entries.size() * sizeof(BookEntry));
+    return (bool) out;
+}
+
+// Fits evaluator to game results: first games of random play from the
+// opening, then every game in the record file records unless it is null.
+// Each position of a game is one example, labelled with the final result
+// for its side to move. Returns false if records can't be read.
+bool train_patterns(PatternEvaluator& evaluator, long games, const char* records) {
+    Board positions[64];
+    Player turns[64];
+    auto learn = [&](int count, Board end, double rate) {
+        int margin = end.disks(Player::dark).bits_set() - end.disks(Player::light).bits_set();
+        double dark_result = margin > 0 ? 1 : margin < 0 ? 0 : 0.5;
+        double error = 0;
+        for (int i = 0; i < count; ++i) {
+            double target = turns[i] == Player::dark ? dark_result : 1 - dark_result;
+            error += evaluator.train(positions[i], turns[i], target, rate);
+        }
+
+        return error;
+    };
+
+    double error = 0;
+    long examples = 0;
+    for (long game = 0; game < games; ++game) {
+        Board board = Board::opening_position();
+        Player turn = Player::dark;
+        int count = 0;
+        for (BitBoard moves = board.move_bits(turn); !moves.is_empty(); moves = board.move_bits(turn)) {
+            positions[count] = board;
+            turns[count++] = turn;
+            board = board.place_disk(turn, moves.select_bit(rng.below(moves.bits_set())));
+            turn = opponent(turn);
+        }
+
+        error += learn(count, board, 0.004 * (1 - 0.9 * game / games));
+        examples += count;
+        if ((game + 1) % std::max(1L, games / 10) == 0) {
+            std::cout << "Random games: " << game + 1 << "  Mean squared error: " << error / examples << std::endl;
+            error = 0;
+            examples = 0;
+        }
+    }
+
+    if (records == nullptr) {
+        return true;
+    }
+
+    GameReader reader;
+    if (!reader.open(records)) {
+        return false;
+    }
+
+    long recorded = 0;
+    const RecordHeader* header;
+    const RecordMove* moves;
+    while (reader.next(header, moves)) {
+        Board board(BitBoard(header->dark), BitBoard(header->light));
+        Player turn = static_cast<Player>(header->turn);
+        int count = 0;
+        for (int i = 0; i < header->move_count && count < 64; ++i) {
+            positions[count] = board;
+            turns[count++] = turn;
+            board = board.place_disk(turn, moves[i].square);
+            turn = opponent(turn);
+        }
+
+        error += learn(count, board, 0.002);
+        examples += count;
+        ++recorded;
+    }
+
+    std::cout << "Recorded games: " << recorded << "  Mean squared error: " << error / std::max(1L, examples)
+              << std::endl;
+    return true;
+}
+
+// Random plies played from the opening position before a tournament game.
+#define OPENING_PLIES 6
+
+// Reads comma separated key=value settings such as
+// "iterations=20000,exploration=1.2,batch=8" over config. As on the command
+// line, a move-time or game-time leaves the clock alone to end the search
+// unless iterations is given too. Returns false on an unknown key or a
+// malformed value.
+bool parse_engine(const char* spec, SearchConfig& config) {
+    std::string text(spec);
+    size_t start = 0;
+    bool iterations_set = false;
+    bool timed = false;
+    while (start < text.size()) {
+        size_t end = text.find(',', start);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+
+        std::string item = text.substr(start, end - start);
+        start = end + 1;
+        size_t equals = item.find('=');
+        if (equals == std::string::npos) {
+            return false;
+        }
+
+        std::string key = item.substr(0, equals);
+        const char* value = item.c_str() + equals + 1;
+        char* rest;
+        double number = strtod(value, &rest);
+        if (rest == value || *rest != '\0') {
+            return false;
+        }
+
+        if (key == "iterations") {
+            config.iterations = (long) number;
+            iterations_set = true;
+        } else if (key == "move-time") {
+            config.move_time_ms = (long) number;
+            timed |= number > 0;
+        } else if (key == "game-time") {
+            config.game_time_ms = (long) number;
+            timed |= number > 0;
+        } else if (key == "exploration") {
+            config.exploration = number;
+        } else if (key == "batch" && (number == 0 || number == 4 || number == 8 || number == 16)) {
+            config.batch = (int) number;
+        } else if (key == "tt") {
+            config.table_mb = (long) number;
+        } else if (key == "eval") {
+            config.eval_plies = (int) number;
+        } else if (key == "solve") {
+            config.solve_empties = (int) number;
+        } else if (key == "memory") {
+            config.memory_mb = number > 0 ? std::max(64L, (long) number) : 0;
+        } else {
+            return false;
+        }
+    }
+
+    if (timed && !iterations_set) {
+        config.iterations = 0;
+    }
+
+    return true;
+}
+
+// Opening number index: OPENING_PLIES random moves from the start, the same
+// for a given master_seed so that both colour assignments get to play it.
+std::pair<Board, Player> tournament_opening(long index) {
+    uint64_t state = master_seed ^ (index * 0x9e3779b97f4a7c15);
+    Rng generator(splitmix64(state));
+    for (;;) {
+        Board board = Board::opening_position();
+        Player turn = Player::dark;
+        int ply = 0;
+        for (; ply < OPENING_PLIES; ++ply) {
+            BitBoard moves = board.move_bits(turn);
+            if (moves.is_empty()) {
+                break;
+            }
+
+            board = board.place_disk(turn, moves.select_bit(generator.below(moves.bits_set())));
+            turn = opponent(turn);
+        }
+
+        if (ply == OPENING_PLIES && !board.move_bits(turn).is_empty()) {
+            return std::make_pair(board, turn);
+        }
+    }
+}
+
+// Plays one silent game from start between two engines, each with a tree
+// of its own searching on one thread and seeded from seed. Returns 1, 0 or
+// -1 as first wins, draws or loses. Moves are added to record unless it is
+// null.
+int tournament_game(SearchConfig& first, SearchConfig& second, Board start, Player turn, Player first_colour,
+                    uint64_t seed, GameRecord* record) {
+    Tree first_tree(start, turn, first.table_mb);
+    Tree second_tree(start, turn, second.table_mb);
+    first_tree.set_seed(splitmix64(seed));
+    second_tree.set_seed(splitmix64(seed));
+    apply_config(first_tree, first);
+    apply_config(second_tree, second);
+    Clock first_clock(first.game_time_ms);
+    Clock second_clock(second.game_time_ms);
+
+    Board board = start;
+    while (!board.move_bits(turn).is_empty()) {
+        bool first_to_move = turn == first_colour;
+        SearchConfig& config = first_to_move ? first : second;
+        Tree& tree = first_to_move ? first_tree : second_tree;
+        Clock& clock = first_to_move ? first_clock : second_clock;
+
+        int square = config.book != nullptr ? config.book->probe(board, turn) : -1;
+        if (square >= 0) {
+            board = board.place_disk(turn, square);
+            if (record != nullptr) {
+                record->add(tree.get_root(), board, RECORD_BOOK);
+            }
+
+            first_tree.advance(board);
+            second_tree.advance(board);
+            turn = opponent(turn);
+            continue;
+        }
+
+        long time_ms = config.move_time_ms;
+        if (config.game_time_ms > 0) {
+            long budget = clock.budget(board);
+            time_ms = time_ms > 0 ? std::min(time_ms, budget) : budget;
+        }
+
+        if (config.root_parallel != nullptr) {
+            RootResult merged = config.root_parallel->search(board, turn, config.iterations, time_ms);
+            clock.consume(merged.seconds);
+            board = board.place_disk(turn, merged.square);
+        } else {
+            SearchResult result = tree.search(config.iterations, 1, time_ms, config.batch,
+                                              config.solve_empties, config.exploration, nullptr);
+            clock.consume(result.seconds);
+            board = tree.get_root().best_move().get_board();
+        }
+
+        if (record != nullptr) {
+            record->add(tree.get_root(), board, 0);
+        }
+
+        first_tree.advance(board);
+        second_tree.advance(board);
+        turn = opponent(turn);
+    }
+
+    if (record != nullptr) {
+        record->finish(board);
+    }
+
+    if (board.is_winner(first_colour)) {
+        return 1;
+    } else if (board.is_winner(opponent(first_colour))) {
+        return -1;
+    }
+
+    return 0;
+}
+
+// Score of engine A from its wins, draws and losses, with a 95% confidence
+// interval from the per-game score variance, and the matching Elo range.
+void tournament_summary(long wins, long draws, long losses, double seconds) {
+    long games = wins + draws + losses;
+    double score = (wins + 0.5 * draws) / games;
+    double variance = (wins * (1 - score) * (1 - score) + draws * (0.5 - score) * (0.5 - score)
+                       + losses * score * score) / games;
+    double margin = 1.96 * sqrt(variance / games);
+    auto elo = [](double s) {
+        s = std::min(std::max(s, 0.001), 0.999);
+        return -400 * log10(1 / s - 1);
+    };
+
+    std::cout << "Games: " << games << "  A wins: " << wins << "  Draws: " << draws << "  A losses: " << losses
+              << "  Score: " << score << " +/- " << margin
+              << "  Elo: " << elo(score) << " [" << elo(score - margin) << ", " << elo(score + margin) << "]"
+              << "  Games/hour: " << (long) (games / seconds * 3600) << std::endl;
+}
+
+// Plays games between engines a and b on a pool of threads. Game i starts
+// from opening i / 2, with A taking dark in even games and light in odd ones.
+// Games are written to writer unless it is null.
+void tournament(long games, int threads, SearchConfig a, SearchConfig b, GameWriter* writer) {
+    std::atomic<long> next(0);
+    long wins = 0;
+    long draws = 0;
+    long losses = 0;
+    std::mutex results_lock;
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed = [&start]() {
+        std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+        return seconds.count();
+    };
+
+    auto worker = [&]() {
+        for (long game = next++; game < games; game = next++) {
+            std::pair<Board, Player> opening = tournament_opening(game / 2);
+            Player a_colour = game % 2 == 0 ? Player::dark : Player::light;
+            GameRecord record(opening.first, opening.second);
+            // Games get seeds of their own, or equal engines would replay
+            // the same game from every colour assignment of an opening.
+            int result = tournament_game(a, b, opening.first, opening.second, a_colour, master_seed + game,
+                                         writer != nullptr ? &record : nullptr);
+            if (writer != nullptr) {
+                writer->append(record);
+            }
+
+            std::lock_guard<std::mutex> lock(results_lock);
+            wins += result > 0;
+            draws += result == 0;
+            losses += result < 0;
+            if ((wins + draws + losses) % 100 == 0) {
+                tournament_summary(wins, draws, losses, elapsed());
+            }
+        }
+    };
+
+    std::cout << "Tournament  Games: " << games << "  Threads: " << threads << "  Seed: " << master_seed << std::endl;
+    std::vector<std::thread> workers;
+    for (int i = 1; i < threads; ++i) {
+        workers.emplace_back(worker);
+    }
+
+    worker();
+    for (std::thread& t : workers) {
+        t.join();
+    }
+
+    if (games % 100 != 0) {
+        tournament_summary(wins, draws, losses, elapsed());
+    }
+}
+
+// Root-parallel search at 1, 2, 4, ... worker processes, always finishing
+// with max_workers: the summed iterations per second of one search from the
+// opening, then games against a single tree given the iterations of one
+// worker. False if the workers could not be started.
+bool root_report(int max_workers, long games, SearchConfig config) {
+    std::cout << "Root-parallel report  Iterations per worker: " << config.iterations
+              << "  Games: " << games << "  Seed: " << master_seed << std::endl;
+    double base_rate = 0;
+    for (int workers = 1; ; workers *= 2) {
+        if (workers > max_workers) {
+            workers = max_workers;
+        }
+
+        RootParallel pool;
+        if (!pool.start(workers, config)) {
+            return false;
+        }
+
+        // The first round only warms the workers up.
+        pool.search(Board::opening_position(), Player::dark, config.iterations, 0);
+        RootResult result = pool.search(Board::opening_position(), Player::dark, config.iterations, 0);
+        double rate = result.iterations / result.seconds;
+        if (workers == 1) {
+            base_rate = rate;
+        }
+
+        std::cout << "Workers: " << workers
+                  << "  Iterations/sec: " << (long) rate
+                  << "  Speedup: " << rate / base_rate << std::endl;
+
+        SearchConfig parallel = config;
+        parallel.root_parallel = &pool;
+        long wins = 0;
+        long draws = 0;
+        long losses = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (long game = 0; game < games; ++game) {
+            std::pair<Board, Player> opening = tournament_opening(game / 2);
+            Player colour = game % 2 == 0 ? Player::dark : Player::light;
+            int outcome = tournament_game(parallel, config, opening.first, opening.second, colour,
+                                          master_seed + game, nullptr);
+            wins += outcome > 0;
+            draws += outcome == 0;
+            losses += outcome < 0;
+        }
+
+        if (games > 0) {
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            tournament_summary(wins, draws, losses, elapsed.count());
+        }
+
+        if (workers == max_workers) {
+            break;
+        }
+    }
+
+    return true;
+}
+
+// A bitboard field of an analysis line, decimal or 0x hex.
+bool parse_bitboard(const std::string& text, uint64_t& bits) {
+    bool hex = text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X');
+    const char* digits = text.c_str() + (hex ? 2 : 0);
+    if (!isxdigit((unsigned char) digits[0]) || (!hex && !isdigit((unsigned char) digits[0]))) {
+        return false;
+    }
+
+    char* end = nullptr;
+    errno = 0;
+    bits = strtoull(digits, &end, hex ? 16 : 10);
+    return errno == 0 && *end == '\0';
+}
+
+// Searches the position on one line of an analysis file with tree and
+// returns its JSON result: the best move, that move's win rate for the side
+// to move and the visits of every root move that was searched.
+std::string analyse_position(Tree& tree, SearchConfig& config, long line, const std::string& text) {
+    std::istringstream fields(text);
+    std::string dark_text, light_text, side, extra;
+    uint64_t dark = 0;
+    uint64_t light = 0;
+    std::ostringstream out;
+    out << "{\"line\":" << line;
+    if (!(fields >> dark_text >> light_text >> side) || (fields >> extra) || !parse_bitboard(dark_text, dark)
+        || !parse_bitboard(light_text, light) || (dark & light) != 0 || (side != "x" && side != "o")) {
+        out << ",\"error\":\"expected dark and light bitboards and x or o\"}";
+        return out.str();
+    }
+
+    Board board = Board(BitBoard(dark), BitBoard(light));
+    Player turn = side == "x" ? Player::dark : Player::light;
+    if (board.move_bits(turn).is_empty()) {
+        out << ",\"best\":\"none\",\"iterations\":0}";
+        return out.str();
+    }
+
+    // Seeded from the line, so a position gets the same search whichever
+    // worker picks it up.
+    uint64_t state = master_seed + line;
+    tree.reset(board, turn);
+    tree.set_seed(splitmix64(state));
+    SearchResult result = tree.search(config.iterations, 1, config.move_time_ms, config.batch,
+                                      config.solve_empties, config.exploration, nullptr);
+
+    Node& root = tree.get_root();
+    Node& best = root.best_move();
+    int square = __builtin_ctzll((best.get_board().occupied() & ~board.occupied()).get_bits());
+    out << ",\"best\":\"" << square_name(square) << "\""
+        << ",\"value\":" << (best.get_simulations() > 0 ? 1 - best.confidence() : 0.5)
+        << ",\"iterations\":" << result.iterations
+        << ",\"visits\":{";
+    const char* separator = "";
+    for (int slot = 0; slot < root.child_count(); ++slot) {
+        Node* child = root.child(slot);
+        if (child == nullptr) {
+            continue;
+        }
+
+        square = __builtin_ctzll((child->get_board().occupied() & ~board.occupied()).get_bits());
+        out << separator << "\"" << square_name(square) << "\":" << child->get_simulations();
+        separator = ",";
+    }
+
+    out << "}}";
+    return out.str();
+}
+
+// Offline analysis of a file of positions, "-" for stdin. Each line holds
+// the dark and light bitboards and x or o for the side to move; blank lines
+// and lines starting with # are skipped. workers threads each keep one tree
+// (and its transposition table, so with --tt a result also depends on what
+// that worker searched before) and search one position at a time on a
+// single thread. Results are written as JSON lines in input order. The
+// reader stays at most a window of positions ahead of the writer, so memory
+// does not grow with the file. False if path can't be read.
+bool analyse_positions(const char* path, int workers, SearchConfig config) {
+    std::ifstream file;
+    std::istream* in = &std::cin;
+    if (strcmp(path, "-") != 0) {
+        file.open(path);
+        if (!file) {
+            return false;
+        }
+
+        in = &file;
+    }
+
+    // A ring of positions read but not yet written. Slot i % size holds the
+    // i-th position, then its result once done.
+    struct AnalysisSlot {
+        long line;
+        std::string text;
+        bool done;
+    };
+
+    std::vector<AnalysisSlot> window(4 * workers);
+    long read = 0;    // positions put in the window
+    long taken = 0;   // positions handed to a worker
+    long written = 0; // results written out
+    bool eof = false;
+    std::mutex window_lock;
+    std::condition_variable changed;
+
+    auto worker = [&]() {
+        Tree tree(Board::opening_position(), Player::dark, config.table_mb);
+        apply_config(tree, config);
+        std::unique_lock<std::mutex> lock(window_lock);
+        for (;;) {
+            changed.wait(lock, [&]() { return taken < read || eof; });
+            if (taken == read) {
+                return;
+            }
+
+            AnalysisSlot& slot = window[taken++ % window.size()];
+            long line = slot.line;
+            std::string text = slot.text;
+            lock.unlock();
+            std::string result = analyse_position(tree, config, line, text);
+            lock.lock();
+            slot.text.swap(result);
+            slot.done = true;
+            changed.notify_all();
+        }
+    };
+
+    auto writer = [&]() {
+        std::unique_lock<std::mutex> lock(window_lock);
+        for (;;) {
+            changed.wait(lock, [&]() { return window[written % window.size()].done || (eof && written == read); });
+            AnalysisSlot& slot = window[written % window.size()];
+            if (!slot.done) {
+                return;
+            }
+
+            std::string result;
+            result.swap(slot.text);
+            slot.done = false;
+            ++written;
+            changed.notify_all();
+            lock.unlock();
+            std::cout << result << '\n';
+            lock.lock();
+        }
+    };
+
+    std::thread output(writer);
+    std::vector<std::thread> pool;
+    for (int i = 0; i < workers; ++i) {
+        pool.emplace_back(worker);
+    }
+
+    std::string text;
+    long line = 0;
+    while (std::getline(*in, text)) {
+        ++line;
+        size_t start = text.find_first_not_of(" \t\r");
+        if (start == std::string::npos || text[start] == '#') {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(window_lock);
+        changed.wait(lock, [&]() { return read - written < (long) window.size(); });
+        AnalysisSlot& slot = window[read++ % window.size()];
+        slot.line = line;
+        slot.text.swap(text);
+        slot.done = false;
+        changed.notify_all();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(window_lock);
+        eof = true;
+        changed.notify_all();
+    }
+
+    for (std::thread& t : pool) {
+        t.join();
+    }
+
+    output.join();
+    std::cout << std::flush;
+    return true;
+}
+
+// Long-lived engine driven over stdin/stdout, one command per line:
+//
+//   new                          start from the opening, dark to move
+//   position <64 squares> <x|o>  a1..h8, x dark, o light, - empty
+//   play <square>                apply a move; pass when there is none
+//   go [iterations N] [movetime MS] [time MS] [infinite]
+//   stop                         end a running go early
+//   analyse                      root moves with visits and win rates
+//   board  isready  quit
+//
+// Replies are "ok", "error <reason>" or "readyok"; a go answers later with
+// an info line and "bestmove <square>" once it stops. The tree and the
+// transposition table stay warm between commands, and analyse may be asked
+// while a search is running.
+class EngineProtocol {
+private:
+    SearchConfig config;
+    Tree tree;
+    std::thread searcher;
+    std::atomic<bool> stop;
+    std::mutex output;
+
+    void reply(const std::string& line) {
+        std::lock_guard<std::mutex> lock(output);
+        std::cout << line << std::endl;
+    }
+
+    void finish_search() {
+        if (searcher.joinable()) {
+            stop.store(true);
+            searcher.join();
+        }
+    }
+
+    Board root_board() {
+        return tree.get_root().get_board();
+    }
+
+    Player root_turn() {
+        return tree.get_root().get_turn();
+    }
+
+    void go(std::istream& args) {
+        long iterations = 0;
+        long time_ms = config.move_time_ms;
+        bool infinite = false;
+        std::string key;
+        while (args >> key) {
+            if (key == "infinite") {
+                infinite = true;
+                continue;
+            }
+
+            // Every other key takes a number.
+            long value = 0;
+            if ((key != "iterations" && key != "movetime" && key != "time") || !(args >> value)) {
+                reply("error bad go argument " + key);
+                return;
+            }
+
+            if (key == "iterations") {
+                iterations = std::max(1L, value);
+            } else if (key == "movetime") {
+                time_ms = std::max(1L, value);
+            } else {
+                time_ms = Clock(value).budget(root_board());
+            }
+        }
+
+        if (infinite) {
+            iterations = 0;
+            time_ms = 0;
+        } else if (iterations == 0 && time_ms <= 0) {
+            iterations = config.iterations;
+        }
+
+        int square = config.book != nullptr ? config.book->probe(root_board(), root_turn()) : -1;
+        if (square >= 0 && !infinite) {
+            std::lock_guard<std::mutex> lock(output);
+            std::cout << "info book" << std::endl;
+            std::cout << "bestmove " << square_name(square) << std::endl;
+            return;
+        }
+
+        apply_config(tree, config);
+        stop.store(false);
+        searcher = std::thread([this, iterations, time_ms]() {
+            SearchResult result = tree.search(iterations, config.threads, time_ms, config.batch,
+                                              config.solve_empties, config.exploration, &stop);
+            Node& root = tree.get_root();
+            std::lock_guard<std::mutex> lock(output);
+            std::cout << "info iterations " << result.iterations
+                      << " nps " << (long) (result.iterations / std::max(result.seconds, 1e-9))
+                      << " depth " << result.max_depth
+                      << " nodes " << tree.node_count()
+                      << " bytes " << tree.node_bytes()
+                      << " confidence " << (root.get_simulations() > 0 ? root.confidence() : 0.5) << std::endl;
+            if (root.child_count() == 0) {
+                std::cout << "bestmove none" << std::endl;
+            } else {
+                Board move = root.best_move().get_board();
+                int square = __builtin_ctzll((move.occupied() & ~root.get_board().occupied()).get_bits());
+                std::cout << "bestmove " << square_name(square) << std::endl;
+            }
+        });
+    }
+
+    void analyse() {
+        std::unique_lock<std::mutex> layout = tree.lock_layout();
+        Node& root = tree.get_root();
+        Board board = root.get_board();
+        std::vector<std::pair<int, std::string>> lines;
+        for (int slot = 0; slot < root.child_count(); ++slot) {
+            if (root.child(slot) == nullptr) {
+                continue;
+            }
+
+            Node& child = *root.child(slot);
+            int visits = child.get_simulations();
+            int square = __builtin_ctzll((child.get_board().occupied() & ~board.occupied()).get_bits());
+            double rate = visits > 0 ? 1 - child.confidence() : 0.5;
+            lines.emplace_back(visits, "analysis " + square_name(square) + " visits " + std::to_string(visits)
+                                       + " winrate " + std::to_string(rate));
+        }
+
+        std::sort(lines.begin(), lines.end(), [](const std::pair<int, std::string>& a,
+                                                 const std::pair<int, std::string>& b) {
+            return a.first > b.first;
+        });
+
+        std::lock_guard<std::mutex> lock(output);
+        for (std::pair<int, std::string>& line : lines) {
+            std::cout << line.second << std::endl;
+        }
+
+        std::cout << "ok" << std::endl;
+    }
+
+    void position(std::istream& args) {
+        std::string squares, side;
+        if (!(args >> squares >> side) || squares.size() != 64 || (side != "x" && side != "o")) {
+            reply("error position takes 64 squares of x, o or - and the side to move");
+            return;
+        }
+
+        uint64_t dark = 0;
+        uint64_t light = 0;
+        for (int square = 0; square < 64; ++square) {
+            char c = squares[square];
+            if (c == 'x') {
+                dark |= (uint64_t) 1 << square;
+            } else if (c == 'o') {
+                light |= (uint64_t) 1 << square;
+            } else if (c != '-') {
+                reply("error bad square character");
+                return;
+            }
+        }
+
+        tree.reset(Board(BitBoard(dark), BitBoard(light)), side == "x" ? Player::dark : Player::light);
+        reply("ok");
+    }
+
+    void play(std::istream& args) {
+        std::string name;
+        args >> name;
+        Board board = root_board();
+        Player turn = root_turn();
+        BitBoard moves = board.move_bits(turn);
+        if (name == "pass") {
+            if (!moves.is_empty()) {
+                reply("error pass with legal moves");
+                return;
+            }
+
+            tree.reset(board, opponent(turn));
+            reply("ok");
+            return;
+        }
+
+        int square = parse_square(name);
+        if (square < 0 || ((moves.get_bits() >> square) & 1) == 0) {
+            reply("error illegal move " + name);
+            return;
+        }
+
+        tree.advance(board.place_disk(turn, square));
+        reply("ok");
+    }
+
+public:
+    EngineProtocol(SearchConfig config)
+        : config(config), tree(Board::opening_position(), Player::dark, config.table_mb), stop(false) {}
+
+    ~EngineProtocol() {
+        finish_search();
+    }
+
+    // Reads commands until quit or the end of input.
+    void run(std::istream& in) {
+        std::string line;
+        while (std::getline(in, line)) {
+            std::istringstream args(line);
+            std::string command;
+            if (!(args >> command)) {
+                continue;
+            }
+
+            if (command == "quit") {
+                break;
+            } else if (command == "isready") {
+                reply("readyok");
+            } else if (command == "stop") {
+                finish_search();
+            } else if (command == "analyse") {
+                analyse();
+            } else {
+                // Everything else changes or shows the root, so any running
+                // search finishes (and reports) first.
+                finish_search();
+                if (command == "new") {
+                    tree.reset(Board::opening_position(), Player::dark);
+                    reply("ok");
+                } else if (command == "position") {
+                    position(args);
+                } else if (command == "play") {
+                    play(args);
+                } else if (command == "go") {
+                    go(args);
+                } else if (command == "board") {
+                    std::lock_guard<std::mutex> lock(output);
+                    root_board().display();
+                } else {
+                    reply("error unknown command " + command);
+                }
+            }
+        }
+    }
+};
+
+int main(int argc, char** argv) {
+    master_seed = ((uint64_t) std::random_device{}() << 32) ^ std::random_device{}();
+
+    SearchConfig config{1, 250000, 0, 0, 0, 0, SOLVE_EMPTIES, false, EXPLORATION, nullptr, nullptr, -1, 0, nullptr};
+    bool iterations_set = false;
+    bool threads_set = false;
+    bool protocol = false;
+    const char* book_path = nullptr;
+    const char* build_book_path = nullptr;
+    int book_plies = 4;
+    const char* record_path = nullptr;
+    const char* dump_path = nullptr;
+    const char* patterns_path = nullptr;
+    const char* train_path = nullptr;
+    const char* train_records = nullptr;
+    long train_games = 300000;
+    long tournament_games = 0;
+    int root_workers = 0;
+    long root_report_games = -1;
+    const char* engine_a = "";
+    const char* engine_b = "";
+    bool scaling = false;
+    bool batch_compare = false;
+    int endgame_empties = 0;
+    int validate_games = 0;
+    int bench_depth = 0;
+    const char* analyse_path = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            config.threads = std::max(1, atoi(argv[++i]));
+            threads_set = true;
+        } else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            config.iterations = std::max(1L, atol(argv[++i]));
+            iterations_set = true;
+        } else if (strcmp(argv[i], "--move-time") == 0 && i + 1 < argc) {
+            config.move_time_ms = std::max(1L, atol(argv[++i]));
+        } else if (strcmp(argv[i], "--game-time") == 0 && i + 1 < argc) {
+            config.game_time_ms = std::max(1L, atol(argv[++i]));
+        } else if (strcmp(argv[i], "--kernel") == 0 && i + 1 < argc) {
+            const char* name = argv[++i];
+            bool found = false;
+            for (MoveKernelInfo& info : move_kernels()) {
+                if (strcmp(info.name, name) == 0 && info.supported) {
+                    move_kernel = info;
+                    found = true;
+                }
+            }
+
+            if (!found) {
+                std::cout << "Error: move kernel " << name << " not available" << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            config.batch = atoi(argv[++i]);
+            if (config.batch != 4 && config.batch != 8 && config.batch != 16) {
+                std::cout << "Error: --batch takes 4, 8 or 16 lanes" << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--tt") == 0 && i + 1 < argc) {
+            config.table_mb = std::max(0L, atol(argv[++i]));
+        } else if (strcmp(argv[i], "--memory") == 0 && i + 1 < argc) {
+            // Below this the arena blocks alone would overrun the cap.
+            config.memory_mb = std::max(64L, atol(argv[++i]));
+        } else if (strcmp(argv[i], "--exploration") == 0 && i + 1 < argc) {
+            config.exploration = std::max(0.0, atof(argv[++i]));
+        } else if (strcmp(argv[i], "--analyse") == 0 && i + 1 < argc) {
+            analyse_path = argv[++i];
+        } else if (strcmp(argv[i], "--tournament") == 0 && i + 1 < argc) {
+            tournament_games = std::max(1L, atol(argv[++i]));
+        } else if (strcmp(argv[i], "--root-workers") == 0 && i + 1 < argc) {
+            root_workers = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--root-report") == 0 && i + 1 < argc) {
+            root_report_games = std::max(0L, atol(argv[++i]));
+        } else if (strcmp(argv[i], "--engine-a") == 0 && i + 1 < argc) {
+            engine_a = argv[++i];
+        } else if (strcmp(argv[i], "--engine-b") == 0 && i + 1 < argc) {
+            engine_b = argv[++i];
+        } else if (strcmp(argv[i], "--book") == 0 && i + 1 < argc) {
+            book_path = argv[++i];
+        } else if (strcmp(argv[i], "--build-book") == 0 && i + 1 < argc) {
+            build_book_path = argv[++i];
+        } else if (strcmp(argv[i], "--book-plies") == 0 && i + 1 < argc) {
+            book_plies = std::max(0, std::min(10, atoi(argv[++i])));
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            record_path = argv[++i];
+        } else if (strcmp(argv[i], "--dump-games") == 0 && i + 1 < argc) {
+            dump_path = argv[++i];
+        } else if (strcmp(argv[i], "--patterns") == 0 && i + 1 < argc) {
+            patterns_path = argv[++i];
+        } else if (strcmp(argv[i], "--eval") == 0 && i + 1 < argc) {
+            config.eval_plies = std::max(0, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--train-patterns") == 0 && i + 1 < argc) {
+            train_path = argv[++i];
+        } else if (strcmp(argv[i], "--train-games") == 0 && i + 1 < argc) {
+            train_games = std::max(0L, atol(argv[++i]));
+        } else if (strcmp(argv[i], "--train-records") == 0 && i + 1 < argc) {
+            train_records = argv[++i];
+        } else if (strcmp(argv[i], "--protocol") == 0) {
+            protocol = true;
+        } else if (strcmp(argv[i], "--ponder") == 0) {
+            config.ponder = true;
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            master_seed = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--solve") == 0 && i + 1 < argc) {
+            config.solve_empties = std::max(0, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--endgame-bench") == 0 && i + 1 < argc) {
+            endgame_empties = std::max(1, std::min(60, atoi(argv[++i])));
+        } else if (strcmp(argv[i], "--validate-flips") == 0 && i + 1 < argc) {
+            validate_games = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--bench") == 0) {
+            bench_depth = 10;
+            if (i + 1 < argc && isdigit(argv[i + 1][0])) {
+                bench_depth = std::max(1, atoi(argv[++i]));
+            }
+        } else if (strcmp(argv[i], "--batch-compare") == 0) {
+            batch_compare = true;
+        } else if (strcmp(argv[i], "--scaling") == 0) {
+            scaling = true;
+        } else {
+            std::cout << "Usage: " << argv[0]
+                      << " [--threads N] [--iterations N] [--move-time MS] [--game-time MS]"
+                      << " [--kernel scalar|avx2|avx512] [--batch 4|8|16] [--tt MB] [--memory MB]"
+                      << " [--solve EMPTIES] [--seed N] [--ponder] [--protocol]"
+                      << " [--book FILE] [--build-book FILE [--book-plies N]]"
+                      << " [--record FILE] [--dump-games FILE]"
+                      << " [--patterns FILE [--eval PLIES]]"
+                      << " [--train-patterns FILE [--train-games N] [--train-records FILE]]"
+                      << " [--exploration C] [--tournament GAMES [--engine-a SPEC] [--engine-b SPEC]]"
+                      << " [--root-workers N] [--root-report GAMES] [--analyse FILE]"
+                      << " [--scaling] [--batch-compare] [--endgame-bench EMPTIES]"
+                      << " [--validate-flips GAMES] [--bench [PERFT_DEPTH]]"
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    rng.seed(master_seed);
+
+    if (scaling) {
+        scaling_report(config.threads, config.iterations);
+        return 0;
+    }
+
+    if (batch_compare) {
+        batch_report(config.iterations);
+        return 0;
+    }
+
+    if (bench_depth > 0) {
+        return bench(bench_depth) ? 0 : 1;
+    }
+
+    if (validate_games > 0) {
+        return validate_flips(validate_games) ? 0 : 1;
+    }
+
+    if (endgame_empties > 0) {
+        endgame_report(endgame_empties, 20);
+        return 0;
+    }
+
+    if (dump_path != nullptr) {
+        if (!dump_games(dump_path)) {
+            std::cout << "Error: " << dump_path << " is not a readable game record file" << std::endl;
+            return 1;
+        }
+
+        return 0;
+    }
+
+    // Under a time control the clock alone ends the search unless an
+    // iteration cap was asked for explicitly.
+    if ((config.move_time_ms > 0 || config.game_time_ms > 0) && !iterations_set) {
+        config.iterations = 0;
+    }
+
+    // The coordinator's own tree is never searched, so there would be no
+    // visits or confidence to record either.
+    if (root_workers > 0 && root_report_games < 0
+        && (protocol || tournament_games > 0 || config.ponder || analyse_path != nullptr || record_path != nullptr)) {
+        std::cout << "Error: --root-workers only drives a plain game without --record, or --root-report"
+                  << std::endl;
+        return 1;
+    }
+
+    PatternEvaluator evaluator;
+    if (train_path != nullptr) {
+        if (!train_patterns(evaluator, train_games, train_records)) {
+            std::cout << "Error: " << train_records << " is not a readable game record file" << std::endl;
+            return 1;
+        }
+
+        if (!evaluator.save(train_path)) {
+            std::cout << "Error: could not write " << train_path << std::endl;
+            return 1;
+        }
+
+        return 0;
+    }
+
+    if (patterns_path != nullptr) {
+        if (!evaluator.load(patterns_path)) {
+            std::cout << "Error: " << patterns_path << " is not a readable pattern weights file" << std::endl;
+            return 1;
+        }
+
+        config.evaluator = &evaluator;
+    } else if (config.eval_plies >= 0) {
+        std::cout << "Error: --eval needs --patterns" << std::endl;
+        return 1;
+    }
+
+    GameWriter writer;
+    if (record_path != nullptr && !writer.open(record_path)) {
+        std::cout << "Error: could not write " << record_path << std::endl;
+        return 1;
+    }
+
+    if (build_book_path != nullptr) {
+        if (!build_book(build_book_path, book_plies, config)) {
+            std::cout << "Error: could not write " << build_book_path << std::endl;
+            return 1;
+        }
+
+        return 0;
+    }
+
+    OpeningBook book;
+    if (book_path != nullptr) {
+        if (!book.open(book_path)) {
+            std::cout << "Error: " << book_path << " is not a readable book" << std::endl;
+            return 1;
+        }
+
+        config.book = &book;
+    }
+
+    if (root_report_games >= 0) {
+        int workers = root_workers > 0 ? root_workers : std::max(1, (int) std::thread::hardware_concurrency());
+        if (!root_report(workers, root_report_games, config)) {
+            std::cout << "Error: could not start root-parallel workers" << std::endl;
+            return 1;
+        }
+
+        return 0;
+    }
+
+    if (analyse_path != nullptr) {
+        // Like a tournament, one search thread per position and a pool of
+        // every core unless --threads says otherwise.
+        int pool = threads_set ? config.threads : std::max(1, (int) std::thread::hardware_concurrency());
+        if (!analyse_positions(analyse_path, pool, config)) {
+            std::cout << "Error: could not read " << analyse_path << std::endl;
+            return 1;
+        }
+
+        return 0;
+    }
+
+    if (protocol) {
+        EngineProtocol engine(config);
+        engine.run(std::cin);
+        return 0;
+    }
+
+    if (tournament_games > 0) {
+        // Each game searches on one thread, so the pool takes every core
+        // unless --threads says otherwise.
+        int pool = threads_set ? config.threads : std::max(1, (int) std::thread::hardware_concurrency());
+        SearchConfig a = config;
+        SearchConfig b = config;
+        if (!parse_engine(engine_a, a) || !parse_engine(engine_b, b)) {
+            std::cout << "Error: engine settings are key=value pairs of iterations, move-time,"
+                      << " game-time, exploration, batch, tt, eval, solve and memory" << std::endl;
+            return 1;
+        }
+
+        if ((a.eval_plies >= 0 || b.eval_plies >= 0) && config.evaluator == nullptr) {
+            std::cout << "Error: eval needs --patterns" << std::endl;
+            return 1;
+        }
+
+        tournament(tournament_games, pool, a, b, record_path != nullptr ? &writer : nullptr);
+        if (record_path != nullptr && !writer.close()) {
+            std::cout << "Error: could not write " << record_path << std::endl;
+            return 1;
+        }
+
+        return 0;
+    }
+
+    Clock dark_clock(config.game_time_ms);
+    Clock light_clock(config.game_time_ms);
+    Clock* dark_timer = config.game_time_ms > 0 ? &dark_clock : nullptr;
+    Clock* light_timer = config.game_time_ms > 0 ? &light_clock : nullptr;
+
+    // The workers are forked before any search thread exists.
+    RootParallel root_parallel;
+    if (root_workers > 0) {
+        if (!root_parallel.start(root_workers, config)) {
+            std::cout << "Error: could not start root-parallel workers" << std::endl;
+            return 1;
+        }
+
+        config.root_parallel = &root_parallel;
+    }
+
+    std::cout << "Seed: " << master_seed << std::endl;
+    Board board = Board::opening_position();
+    Tree tree(board, Player::dark, config.table_mb);
+
+    // Pondering needs an opponent with a tree of its own to think against,
+    // so light gets a second engine instance; otherwise both sides share one.
+    std::unique_ptr<Tree> opponent_tree;
+    if (config.ponder) {
+        opponent_tree.reset(new Tree(board, Player::dark, config.table_mb));
+    }
+
+    Tree& light_tree = config.ponder ? *opponent_tree : tree;
+    GameRecord record(board, Player::dark);
+    GameRecord* recording = record_path != nullptr ? &record : nullptr;
+    for (;;) {
+        board = engine_move(tree, config, dark_timer, recording);
+        board.display();
+        if (config.ponder) {
+            opponent_move(light_tree, board);
+        }
+
+        if (board.find_moves(Player::light).empty()) {
+            break;
+        }
+
+        /*int x, y;
+        std::cin >> x;
+        std::cin >> y;
+        board = board.place_disk(Player::light, x, y)
+        board.display */
+        //std::vector<Board> moves = board.find_moves(Player::light);
+        //board = moves[rand() % moves.size()];
+        board = engine_move(light_tree, config, light_timer, recording);
+        board.display();
+        if (config.ponder) {
+            opponent_move(tree, board);
+        }
+
+        if (board.find_moves(Player::dark).empty()) {
+            break;
+        }
+    }
+    
+    if (recording != nullptr) {
+        record.finish(board);
+        writer.append(record);
+        if (!writer.close()) {
+            std::cout << "Error: could not write " << record_path << std::endl;
+        }
+    }
+
     board.display();
     if (board.is_winner(Player::dark)) {
         std::cout << "Dark wins" << std::endl;